@@ -0,0 +1,251 @@
+#include "bit_kernels.h"
+#include <bit>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SIMPLEPLC_BITS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// AVX2 is compiled per function and picked at run time, so no -mavx2 is needed
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SIMPLEPLC_BITS_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    void pack_scalar(const uint8_t* values, size_t count, uint8_t* packed) {
+        for (size_t i = 0; i < count; i += 8) {
+            size_t n = count - i < 8 ? count - i : 8;
+            uint8_t byte = 0;
+            for (size_t bit = 0; bit < n; bit++) {
+                if (values[i + bit]) {
+                    byte = static_cast<uint8_t>(byte | (1u << bit));
+                }
+            }
+            packed[i / 8] = byte;
+        }
+    }
+
+    void unpack_scalar(const uint8_t* packed, size_t count, uint8_t* values) {
+        for (size_t i = 0; i < count; i++) {
+            values[i] = (packed[i / 8] >> (i % 8)) & 0x01;
+        }
+    }
+
+    bool get_bit(const uint8_t* packed, size_t offset) {
+        return (packed[offset / 8] >> (offset % 8)) & 0x01;
+    }
+
+    void set_bit(uint8_t* packed, size_t offset, bool value) {
+        auto mask = static_cast<uint8_t>(1u << (offset % 8));
+        packed[offset / 8] = static_cast<uint8_t>(value ? packed[offset / 8] | mask : packed[offset / 8] & ~mask);
+    }
+
+    size_t first_difference_scalar(const uint8_t* a, const uint8_t* b, size_t size) {
+        size_t i = 0;
+        while (i < size && a[i] == b[i]) {
+            i++;
+        }
+        return i;
+    }
+
+#ifdef SIMPLEPLC_BITS_SSE2
+    // Sixteen bits per step; the tail is left to the scalar loop
+    size_t pack_sse2(const uint8_t* values, size_t count, uint8_t* packed) {
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+            auto mask = static_cast<uint16_t>(~_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero)));
+            std::memcpy(packed + i / 8, &mask, sizeof(mask));
+        }
+        return i;
+    }
+
+    size_t unpack_sse2(const uint8_t* packed, size_t count, uint8_t* values) {
+        const __m128i select = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+        const __m128i one = _mm_set1_epi8(1);
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            uint16_t mask;
+            std::memcpy(&mask, packed + i / 8, sizeof(mask));
+            // Spread byte 0 over lanes 0-7 and byte 1 over lanes 8-15
+            __m128i spread = _mm_cvtsi32_si128(mask);
+            spread = _mm_unpacklo_epi8(spread, spread);
+            spread = _mm_unpacklo_epi16(spread, spread);
+            spread = _mm_unpacklo_epi32(spread, spread);
+            __m128i set = _mm_cmpeq_epi8(_mm_and_si128(spread, select), select);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), _mm_and_si128(set, one));
+        }
+        return i;
+    }
+
+    // True with the offset of the first difference, or false with the number of bytes compared
+    bool first_difference_sse2(const uint8_t* a, const uint8_t* b, size_t size, size_t& offset) {
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            auto equal = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)));
+            if (equal != 0xFFFF) {
+                offset = i + static_cast<size_t>(std::countr_zero(~equal));
+                return true;
+            }
+        }
+        offset = i;
+        return false;
+    }
+#endif
+
+#ifdef SIMPLEPLC_BITS_AVX2
+    bool has_avx2() {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+
+    __attribute__((target("avx2")))
+    size_t pack_avx2(const uint8_t* values, size_t count, uint8_t* packed) {
+        const __m256i zero = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32) {
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+            auto mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, zero)));
+            std::memcpy(packed + i / 8, &mask, sizeof(mask));
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2")))
+    size_t unpack_avx2(const uint8_t* packed, size_t count, uint8_t* values) {
+        const __m256i spread_index = _mm256_setr_epi8(
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+        const __m256i select = _mm256_setr_epi8(
+            1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+            1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+        const __m256i one = _mm256_set1_epi8(1);
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32) {
+            int32_t mask;
+            std::memcpy(&mask, packed + i / 8, sizeof(mask));
+            // Byte n of the mask lands in lanes 8n to 8n+7
+            __m256i spread = _mm256_shuffle_epi8(_mm256_set1_epi32(mask), spread_index);
+            __m256i set = _mm256_cmpeq_epi8(_mm256_and_si256(spread, select), select);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + i), _mm256_and_si256(set, one));
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2")))
+    bool first_difference_avx2(const uint8_t* a, const uint8_t* b, size_t size, size_t& offset) {
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            auto equal = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+            if (equal != 0xFFFFFFFF) {
+                offset = i + static_cast<size_t>(std::countr_zero(~equal));
+                return true;
+            }
+        }
+        offset = i;
+        return false;
+    }
+#endif
+}
+
+namespace bit_kernels {
+
+    void pack(const uint8_t* values, size_t count, uint8_t* packed) {
+        size_t done = 0;
+#ifdef SIMPLEPLC_BITS_AVX2
+        if (has_avx2()) {
+            done = pack_avx2(values, count, packed);
+        }
+#endif
+#ifdef SIMPLEPLC_BITS_SSE2
+        done += pack_sse2(values + done, count - done, packed + done / 8);
+#endif
+        pack_scalar(values + done, count - done, packed + done / 8);
+    }
+
+    void unpack(const uint8_t* packed, size_t count, uint8_t* values) {
+        size_t done = 0;
+#ifdef SIMPLEPLC_BITS_AVX2
+        if (has_avx2()) {
+            done = unpack_avx2(packed, count, values);
+        }
+#endif
+#ifdef SIMPLEPLC_BITS_SSE2
+        done += unpack_sse2(packed + done / 8, count - done, values + done);
+#endif
+        unpack_scalar(packed + done / 8, count - done, values + done);
+    }
+
+    void extract(const uint8_t* packed, size_t offset, size_t count, uint8_t* values) {
+        size_t head = 0;
+        for (; head < count && (offset + head) % 8 != 0; head++) {
+            values[head] = get_bit(packed, offset + head);
+        }
+        unpack(packed + (offset + head) / 8, count - head, values + head);
+    }
+
+    void insert(const uint8_t* values, size_t count, uint8_t* packed, size_t offset) {
+        size_t head = 0;
+        for (; head < count && (offset + head) % 8 != 0; head++) {
+            set_bit(packed, offset + head, values[head] != 0);
+        }
+        // pack() writes whole bytes, so the partial last byte is done bit by bit
+        size_t whole = (count - head) / 8 * 8;
+        pack(values + head, whole, packed + (offset + head) / 8);
+        for (size_t i = head + whole; i < count; i++) {
+            set_bit(packed, offset + i, values[i] != 0);
+        }
+    }
+
+    void copy(const uint8_t* source, size_t source_offset, uint8_t* destination, size_t destination_offset, size_t count) {
+        size_t head = 0;
+        for (; head < count && (destination_offset + head) % 8 != 0; head++) {
+            set_bit(destination, destination_offset + head, get_bit(source, source_offset + head));
+        }
+
+        // Whole destination bytes, each assembled from at most two source bytes
+        const uint8_t* in = source + (source_offset + head) / 8;
+        uint8_t* out = destination + (destination_offset + head) / 8;
+        size_t shift = (source_offset + head) % 8;
+        size_t bytes = (count - head) / 8;
+        if (shift == 0) {
+            std::memcpy(out, in, bytes);
+        } else {
+            for (size_t i = 0; i < bytes; i++) {
+                out[i] = static_cast<uint8_t>((in[i] >> shift) | (in[i + 1] << (8 - shift)));
+            }
+        }
+
+        for (size_t i = head + bytes * 8; i < count; i++) {
+            set_bit(destination, destination_offset + i, get_bit(source, source_offset + i));
+        }
+    }
+
+    size_t first_difference(const uint8_t* a, const uint8_t* b, size_t size) {
+        size_t done = 0;
+        [[maybe_unused]] size_t offset = 0;
+#ifdef SIMPLEPLC_BITS_AVX2
+        if (has_avx2()) {
+            if (first_difference_avx2(a, b, size, offset)) {
+                return offset;
+            }
+            done = offset;
+        }
+#endif
+#ifdef SIMPLEPLC_BITS_SSE2
+        if (first_difference_sse2(a + done, b + done, size - done, offset)) {
+            return done + offset;
+        }
+        done += offset;
+#endif
+        return done + first_difference_scalar(a + done, b + done, size - done);
+    }
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Vectorized kernels for Modbus bit tables
+ *
+ * The process image stores coils and discrete inputs one byte per bit, or
+ * packed like the wire format with eight bits per byte, least significant bit
+ * first. These kernels convert and compare whole ranges 16 (SSE2) or 32 (AVX2)
+ * entries at a time; the offset variants only fall back to single bits at the
+ * unaligned ends of a range. AVX2 is selected at run time when the CPU supports it;
+ * other targets use a scalar fallback.
+ */
+namespace bit_kernels {
+
+    /**
+     * @brief Pack byte-per-bit values into wire format
+     *
+     * @param values One byte per bit, any non-zero byte counts as set
+     * @param count Number of bits
+     * @param packed Output of (count + 7) / 8 bytes; unused high bits of the last byte are cleared
+     */
+    void pack(const uint8_t* values, size_t count, uint8_t* packed);
+
+    /**
+     * @brief Unpack wire-format bits into one byte per bit
+     *
+     * @param packed Input of (count + 7) / 8 bytes
+     * @param count Number of bits
+     * @param values Output of count bytes, each 0 or 1
+     */
+    void unpack(const uint8_t* packed, size_t count, uint8_t* values);
+
+    /**
+     * @brief Unpack bits starting at any bit offset into one byte per bit
+     *
+     * @param packed Packed bits
+     * @param offset Bit offset of the first bit to unpack
+     * @param count Number of bits
+     * @param values Output of count bytes, each 0 or 1
+     */
+    void extract(const uint8_t* packed, size_t offset, size_t count, uint8_t* values);
+
+    /**
+     * @brief Pack byte-per-bit values into packed bits starting at any bit offset
+     *
+     * Bits outside offset .. offset + count - 1 are left unchanged.
+     *
+     * @param values One byte per bit, any non-zero byte counts as set
+     * @param count Number of bits
+     * @param packed Packed bits to update
+     * @param offset Bit offset of the first bit to store
+     */
+    void insert(const uint8_t* values, size_t count, uint8_t* packed, size_t offset);
+
+    /**
+     * @brief Copy a range of packed bits between any two bit offsets
+     *
+     * Bits of the destination outside the range are left unchanged.
+     *
+     * @param source Packed source bits
+     * @param source_offset Bit offset of the first source bit
+     * @param destination Packed destination bits
+     * @param destination_offset Bit offset of the first destination bit
+     * @param count Number of bits
+     */
+    void copy(const uint8_t* source, size_t source_offset, uint8_t* destination, size_t destination_offset, size_t count);
+
+    /**
+     * @brief Find the first byte at which two buffers differ
+     *
+     * @param a First buffer
+     * @param b Second buffer
+     * @param size Number of bytes to compare
+     * @return Offset of the first difference, or size if the buffers are equal
+     */
+    size_t first_difference(const uint8_t* a, const uint8_t* b, size_t size);
+
+}
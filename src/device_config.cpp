@@ -6,6 +6,7 @@
  * the SimplePLC device, including Modbus and OPC UA server settings.
  */
 #include "device_config.h"
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -17,6 +18,8 @@ static DeviceInfo device;                    // Device identification informatio
 static ModbusServerConfig modbus_config;     // Modbus server configuration 
 static OpcUaServerConfig opcua_config;       // OPC UA server configuration
 static std::vector<TagDefinition> tags;      // Tag definitions for data points
+static std::vector<PriorityRule> priority_rules; // Modbus client scheduling weights
+static std::vector<TaskConfig> tasks;        // Cyclic PLC tasks
 
 /**
  * Trims leading and trailing whitespace from a string
@@ -48,6 +51,32 @@ static std::vector<std::string> split(const std::string& s, char delimiter) {
     return tokens;
 }
 
+/**
+ * Parses a list of address blocks, e.g. "0-99, 9000-9999" or "7"
+ * @param key Setting name, for error messages
+ * @param value Comma-separated blocks, each "first-last" (inclusive) or a single address
+ * @param segments Receives the blocks; left unchanged if any block is invalid
+ */
+static void parse_segments(const std::string& key, const std::string& value, std::vector<AddressSegment>& segments) {
+    std::vector<AddressSegment> parsed;
+    for (const auto& block : split(value, ',')) {
+        try {
+            size_t dash = block.find('-');
+            int first = std::stoi(block.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(block.substr(dash + 1));
+            if (first < 0 || last < first || last > 65535) {
+                std::cerr << "[Config] Invalid address block '" << block << "' in " << key << std::endl;
+                return;
+            }
+            parsed.push_back({first, last - first + 1});
+        } catch (const std::exception& e) {
+            std::cerr << "[Config] Error parsing " << key << " block '" << block << "': " << e.what() << std::endl;
+            return;
+        }
+    }
+    segments = parsed;
+}
+
 /**
  * Loads configuration from the specified INI file.
  * Format expected:
@@ -56,6 +85,8 @@ static std::vector<std::string> split(const std::string& s, char delimiter) {
  * 
  * Special handling for [Tags] section where entries are in CSV format:
  * name,address,type
+ * 
+ * Every [Task:<name>] section adds one PLC task.
  */
 void DeviceConfig::load(const std::string& ini_file) {
     std::ifstream file(ini_file);
@@ -68,6 +99,8 @@ void DeviceConfig::load(const std::string& ini_file) {
     
     // Clear the tags list before loading
     tags.clear();
+    priority_rules.clear();
+    tasks.clear();
     
     std::string line, current_section;
     while (std::getline(file, line)) {
@@ -78,6 +111,13 @@ void DeviceConfig::load(const std::string& ini_file) {
         // Process section headers - format: [SectionName]
         if (line.front() == '[' && line.back() == ']') {
             current_section = line.substr(1, line.size() - 2);
+            if (current_section.rfind("Task:", 0) == 0) {
+                TaskConfig task;
+                task.name = current_section.substr(5);
+                trim(task.name);
+                tasks.push_back(task);
+                current_section = "Task";
+            }
             continue;
         }
 
@@ -116,6 +156,13 @@ void DeviceConfig::load(const std::string& ini_file) {
                     device.run_script = value;
                     std::cout << "[Config] Script to run: " << value << std::endl;
                 }
+                else if (key == "scan_period_ms") {
+                    try {
+                        device.scan_period_ms = std::max(std::stoi(value), 1);
+                    } catch (const std::exception& e) {
+                        std::cerr << "[Config] Error parsing scan_period_ms: " << e.what() << std::endl;
+                    }
+                }
             }
             else if (current_section == "ModbusServer") {
                 if (key == "listen") {
@@ -135,6 +182,34 @@ void DeviceConfig::load(const std::string& ini_file) {
                         std::cerr << "[Config] Error parsing max_connections: " << e.what() << std::endl;
                     }
                 }
+                else if (key == "max_connections_per_ip") {
+                    try {
+                        modbus_config.max_connections_per_ip = std::stoi(value);
+                    } catch (const std::exception& e) {
+                        std::cerr << "[Config] Error parsing max_connections_per_ip: " << e.what() << std::endl;
+                    }
+                }
+                else if (key == "connection_slots") {
+                    try {
+                        modbus_config.connection_slots = std::stoi(value);
+                    } catch (const std::exception& e) {
+                        std::cerr << "[Config] Error parsing connection_slots: " << e.what() << std::endl;
+                    }
+                }
+                else if (key == "request_rate") {
+                    try {
+                        modbus_config.request_rate = std::stoi(value);
+                    } catch (const std::exception& e) {
+                        std::cerr << "[Config] Error parsing request_rate: " << e.what() << std::endl;
+                    }
+                }
+                else if (key == "request_burst") {
+                    try {
+                        modbus_config.request_burst = std::stoi(value);
+                    } catch (const std::exception& e) {
+                        std::cerr << "[Config] Error parsing request_burst: " << e.what() << std::endl;
+                    }
+                }
                 else if (key == "mapping_size") {
                     try {
                         modbus_config.mapping_size = std::stoi(value);
@@ -142,6 +217,99 @@ void DeviceConfig::load(const std::string& ini_file) {
                         std::cerr << "[Config] Error parsing mapping_size: " << e.what() << std::endl;
                     }
                 }
+                else if (key == "coils") {
+                    parse_segments(key, value, modbus_config.coils);
+                }
+                else if (key == "discrete_inputs") {
+                    parse_segments(key, value, modbus_config.discrete_inputs);
+                }
+                else if (key == "holding_registers") {
+                    parse_segments(key, value, modbus_config.holding_registers);
+                }
+                else if (key == "input_registers") {
+                    parse_segments(key, value, modbus_config.input_registers);
+                }
+                else if (key == "fifos") {
+                    parse_segments(key, value, modbus_config.fifos);
+                }
+                else if (key == "workers") {
+                    try {
+                        modbus_config.workers = std::stoi(value);
+                    } catch (const std::exception& e) {
+                        std::cerr << "[Config] Error parsing workers: " << e.what() << std::endl;
+                    }
+                }
+                else if (key == "backend") {
+                    modbus_config.backend = value;
+                }
+                else if (key == "bit_layout") {
+                    if (value == "bytes" || value == "packed") {
+                        modbus_config.bit_layout = value;
+                    } else {
+                        std::cerr << "[Config] Unknown bit_layout '" << value << "', using bytes" << std::endl;
+                    }
+                }
+                else if (key == "fair_quantum") {
+                    try {
+                        modbus_config.fair_quantum = std::stoi(value);
+                    } catch (const std::exception& e) {
+                        std::cerr << "[Config] Error parsing fair_quantum: " << e.what() << std::endl;
+                    }
+                }
+                else if (key == "idle_timeout_ms") {
+                    try {
+                        modbus_config.idle_timeout_ms = std::stoi(value);
+                    } catch (const std::exception& e) {
+                        std::cerr << "[Config] Error parsing idle_timeout_ms: " << e.what() << std::endl;
+                    }
+                }
+                else if (key == "frame_timeout_ms") {
+                    try {
+                        modbus_config.frame_timeout_ms = std::stoi(value);
+                    } catch (const std::exception& e) {
+                        std::cerr << "[Config] Error parsing frame_timeout_ms: " << e.what() << std::endl;
+                    }
+                }
+                else if (key == "cpu_affinity") {
+                    modbus_config.cpu_affinity.clear();
+                    for (const auto& cpu : split(value, ',')) {
+                        try {
+                            modbus_config.cpu_affinity.push_back(std::stoi(cpu));
+                        } catch (const std::exception& e) {
+                            std::cerr << "[Config] Error parsing cpu_affinity entry '" << cpu << "': " << e.what() << std::endl;
+                        }
+                    }
+                }
+            }
+            else if (current_section == "Task") {
+                TaskConfig& task = tasks.back();
+                if (key == "script") {
+                    task.script = value;
+                }
+                else if (key == "entry") {
+                    task.entry = value;
+                }
+                else if (key == "period_ms") {
+                    try {
+                        task.period_ms = std::max(std::stoi(value), 1);
+                    } catch (const std::exception& e) {
+                        std::cerr << "[Config] Error parsing period_ms of task " << task.name << ": " << e.what() << std::endl;
+                    }
+                }
+                else if (key == "priority") {
+                    try {
+                        task.priority = std::clamp(std::stoi(value), 0, 99);
+                    } catch (const std::exception& e) {
+                        std::cerr << "[Config] Error parsing priority of task " << task.name << ": " << e.what() << std::endl;
+                    }
+                }
+                else if (key == "cpu") {
+                    try {
+                        task.cpu = std::stoi(value);
+                    } catch (const std::exception& e) {
+                        std::cerr << "[Config] Error parsing cpu of task " << task.name << ": " << e.what() << std::endl;
+                    }
+                }
             }
             else if (current_section == "OPCUA") {
                 if (key == "listen") {
@@ -184,16 +352,36 @@ void DeviceConfig::load(const std::string& ini_file) {
                 std::cerr << "[Config] Invalid tag format: " << line << std::endl;
             }
         }
+        // Process client priorities in CSV format (client,weight)
+        else if (current_section == "Priority") {
+            auto parts = split(line, ',');
+            if (parts.size() >= 2) {
+                try {
+                    PriorityRule rule;
+                    rule.client = parts[0];
+                    rule.weight = std::stoi(parts[1]);
+                    priority_rules.push_back(rule);
+                    std::cout << "[Config] Priority weight " << rule.weight << " for " << rule.client << std::endl;
+                } catch (const std::exception& e) {
+                    std::cerr << "[Config] Error parsing priority rule '" << line << "': " << e.what() << std::endl;
+                }
+            } else {
+                std::cerr << "[Config] Invalid priority format: " << line << std::endl;
+            }
+        }
     }
     
     // Log the loaded configuration
     std::cout << "[Config] Device: " << device.device_id_string
               << ", Slave ID: " << static_cast<int>(device.slave_id) << std::endl;
     std::cout << "[Config] Modbus Server: " << modbus_config.listen_address
-              << ":" << modbus_config.port << std::endl;
+              << ":" << modbus_config.port << ", Workers: " << modbus_config.workers << std::endl;
     std::cout << "[Config] OPC UA Server: " << opcua_config.listen_address
               << ":" << opcua_config.port << std::endl;
     std::cout << "[Config] Loaded " << tags.size() << " tag definitions" << std::endl;
+    if (!tasks.empty()) {
+        std::cout << "[Config] Loaded " << tasks.size() << " PLC tasks" << std::endl;
+    }
 }
 
 const DeviceInfo& DeviceConfig::getDeviceInfo() {
@@ -211,3 +399,11 @@ const OpcUaServerConfig& DeviceConfig::getOpcUaConfig() {
 const std::vector<TagDefinition>& DeviceConfig::getTags() {
     return tags;
 }
+
+const std::vector<PriorityRule>& DeviceConfig::getPriorityRules() {
+    return priority_rules;
+}
+
+const std::vector<TaskConfig>& DeviceConfig::getTasks() {
+    return tasks;
+}
@@ -13,6 +13,29 @@ struct DeviceInfo {
     uint8_t slave_id = 1;
     uint8_t run_indicator = 1;
     std::string run_script = "active.plc";  // Script to run for simulation
+    int scan_period_ms = 1000;              // Scan period of the default task when no [Task:<name>] is configured
+};
+
+/**
+ * @struct AddressSegment
+ * @brief A contiguous block of zero-based Modbus addresses in one table
+ */
+struct AddressSegment {
+    int start;  // First address
+    int count;  // Number of addresses
+};
+
+/**
+ * @struct TaskConfig
+ * @brief A cyclic PLC task from a [Task:<name>] section
+ */
+struct TaskConfig {
+    std::string name;               // Name from the section header
+    std::string script;             // Script the task loads; empty = run_script
+    std::string entry = "cycle";    // Lua function called every scan
+    int period_ms = 1000;           // Scan period, measured start to start; at least 1
+    int priority = 0;               // Real-time priority, 1-99 (SCHED_FIFO on Linux); 0 = normal scheduling
+    int cpu = -1;                   // CPU to pin the task to; -1 = no pinning
 };
 
 /**
@@ -22,8 +45,24 @@ struct DeviceInfo {
 struct ModbusServerConfig {
     std::string listen_address = "0.0.0.0";
     int port = 502;
-    int max_connections = 5;
-    int mapping_size = 255;
+    int max_connections = 1024;      // Clients served at once; further connections are refused; 0 = no limit
+    int max_connections_per_ip = 0;  // Clients served at once from one address; 0 = only max_connections applies
+    int request_rate = 0;            // Sustained requests per second per connection; 0 = unlimited
+    int request_burst = 0;           // Requests a connection may send back to back; 0 = same as request_rate
+    int mapping_size = 255;          // Size of every table without its own address list below, starting at 0
+    std::vector<AddressSegment> coils;              // Coil address blocks; empty = 0 .. mapping_size-1
+    std::vector<AddressSegment> discrete_inputs;    // Discrete input address blocks; empty = 0 .. mapping_size-1
+    std::vector<AddressSegment> holding_registers;  // Holding register address blocks; empty = 0 .. mapping_size-1
+    std::vector<AddressSegment> input_registers;    // Input register address blocks; empty = 0 .. mapping_size-1
+    std::vector<AddressSegment> fifos;              // FIFO pointer addresses served by Read FIFO Queue (FC 0x18)
+    std::string bit_layout = "bytes";  // Coil and discrete input storage: "bytes" (one per bit) or "packed" (eight per byte)
+    int connection_slots = 0;        // Highest client descriptor + 1 that can be served; 0 = max_connections + 1024 (open file limit if unlimited)
+    int workers = 1;                 // Number of worker reactors (SO_REUSEPORT listeners)
+    std::vector<int> cpu_affinity;   // CPUs to pin workers to, assigned round-robin; empty = no pinning
+    std::string backend = "epoll";   // Event loop: "epoll" (select() off Linux) or "io_uring" if built in
+    int fair_quantum = 8;            // Requests served per connection and scheduling round, times its priority weight
+    int idle_timeout_ms = 300000;    // Close connections without a complete request for this long; 0 = never
+    int frame_timeout_ms = 5000;     // Close connections stalled mid-frame for this long; 0 = never
 };
 
 /**
@@ -47,6 +86,15 @@ struct TagDefinition {
     int type;  // 0=Coil, 1=DiscreteInput, 2=HoldingRegister, 3=InputRegister
 };
 
+/**
+ * @struct PriorityRule
+ * @brief Scheduling weight for Modbus clients matched by address or unit ID
+ */
+struct PriorityRule {
+    std::string client;  // IPv4 address, or "unit:<id>" to match the unit identifier
+    int weight;          // Share of each scheduling round relative to the default weight of 1
+};
+
 /**
  * @class DeviceConfig
  * @brief Manages application configuration from settings.ini
@@ -85,4 +133,16 @@ public:
      * @return Const reference to vector of tag definitions
      */
     static const std::vector<TagDefinition>& getTags();
+    
+    /**
+     * @brief Get Modbus client priority rules
+     * @return Const reference to vector of priority rules
+     */
+    static const std::vector<PriorityRule>& getPriorityRules();
+    
+    /**
+     * @brief Get the configured PLC tasks
+     * @return Const reference to vector of tasks, empty if no [Task:<name>] section exists
+     */
+    static const std::vector<TaskConfig>& getTasks();
 };
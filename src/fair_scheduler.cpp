@@ -0,0 +1,36 @@
+#include "fair_scheduler.h"
+#include <algorithm>
+
+FairScheduler::FairScheduler(size_t capacity, int quantum)
+    : slots_(capacity), quantum_(std::max(quantum, 1)) {
+    ready_.reserve(capacity);
+    round_.reserve(capacity);
+}
+
+void FairScheduler::activate(int fd, int weight) {
+    if (fd < 0 || static_cast<size_t>(fd) >= slots_.size()) {
+        return;
+    }
+    Slot& slot = slots_[static_cast<size_t>(fd)];
+    slot.weight = std::max(weight, 1);
+    if (!slot.ready) {
+        slot.ready = true;
+        ready_.push_back(fd);
+    }
+}
+
+void FairScheduler::remove(int fd) {
+    if (fd < 0 || static_cast<size_t>(fd) >= slots_.size()) {
+        return;
+    }
+    Slot& slot = slots_[static_cast<size_t>(fd)];
+    if (slot.ready) {
+        // Closing is rare next to serving, so a linear search is fine
+        auto it = std::find(ready_.begin(), ready_.end(), fd);
+        if (it != ready_.end()) {
+            ready_.erase(it);
+        }
+    }
+    slot.deficit = 0;
+    slot.ready = false;
+}
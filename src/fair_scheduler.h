@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class FairScheduler
+ * @brief Deficit round robin over the connections of one worker
+ *
+ * Connections with work (new data, buffered requests, drained responses)
+ * are activated into a ready list. Each round grants every ready connection
+ * quantum x weight requests on top of what it left unused last round; a
+ * connection that exhausts its budget stays ready for the next round, so a
+ * chatty client can no longer hold the loop for a whole pass and
+ * low-numbered descriptors get no head start. Owned by a single thread.
+ */
+class FairScheduler {
+public:
+    /**
+     * @brief What a connection did with its budget
+     */
+    enum class Outcome {
+        Drained,     ///< No more work until the next readiness event
+        Backlogged,  ///< Budget exhausted with work left; serve again next round
+        Closed       ///< The connection was closed
+    };
+
+    /**
+     * @brief Constructor
+     *
+     * @param capacity Number of descriptors that can be scheduled (0 .. capacity-1)
+     * @param quantum Requests granted per round to a connection of weight 1
+     */
+    FairScheduler(size_t capacity, int quantum);
+
+    /**
+     * @brief Put a connection on the ready list unless it is already there
+     *
+     * @param fd Client socket
+     * @param weight Priority weight of the connection, at least 1
+     */
+    void activate(int fd, int weight);
+
+    /**
+     * @brief Take a closed connection off the ready list
+     *
+     * Its descriptor number may be reused by a connection of another
+     * worker, which this scheduler must never serve.
+     *
+     * @param fd Client socket
+     */
+    void remove(int fd);
+
+    /**
+     * @brief Check whether no connection is waiting to be served
+     *
+     * @return true if the ready list is empty
+     */
+    bool idle() const { return ready_.empty(); }
+
+    /**
+     * @brief Serve every ready connection once
+     *
+     * @param serve Called as serve(fd, budget) -> Outcome; decrements budget per request answered
+     */
+    template <typename Serve>
+    void run_round(Serve&& serve) {
+        round_.swap(ready_);
+        for (int fd : round_) {
+            Slot& slot = slots_[static_cast<size_t>(fd)];
+            slot.deficit += quantum_ * slot.weight;
+
+            int budget = slot.deficit;
+            Outcome outcome = serve(fd, budget);
+            if (outcome == Outcome::Backlogged) {
+                slot.deficit = budget;
+                ready_.push_back(fd);
+            } else {
+                // Standard DRR: an idle flow keeps no credit
+                slot.deficit = 0;
+                slot.ready = false;
+            }
+        }
+        round_.clear();
+    }
+
+private:
+    /**
+     * @brief Scheduling state of one descriptor
+     */
+    struct Slot {
+        int deficit = 0;      ///< Unused budget carried into the next round
+        int weight = 1;       ///< Priority weight
+        bool ready = false;   ///< Whether the descriptor is on the ready list
+    };
+
+    std::vector<Slot> slots_;   ///< Indexed by descriptor
+    std::vector<int> ready_;    ///< Connections to serve in the next round
+    std::vector<int> round_;    ///< Connections being served in the current round
+    int quantum_;               ///< Requests per round per unit of weight
+};
@@ -0,0 +1,50 @@
+#include "fifo_queue.h"
+
+FifoQueue::FifoQueue() {
+    for (size_t i = 0; i < CAPACITY; i++) {
+        ring_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool FifoQueue::push(uint16_t value) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot& slot = ring_[head % CAPACITY];
+        auto lag = static_cast<std::ptrdiff_t>(slot.sequence.load(std::memory_order_acquire) - head);
+        if (lag < 0) {
+            // Still holds the sample pushed one lap earlier
+            return false;
+        }
+        if (lag > 0) {
+            // Another producer claimed this position first
+            head = head_.load(std::memory_order_relaxed);
+        } else if (head_.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+            slot.value = value;
+            slot.sequence.store(head + 1, std::memory_order_release);
+            return true;
+        }
+    }
+}
+
+size_t FifoQueue::pop(uint16_t* values, size_t max) {
+    size_t count = 0;
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    while (count < max) {
+        Slot& slot = ring_[tail % CAPACITY];
+        auto lag = static_cast<std::ptrdiff_t>(slot.sequence.load(std::memory_order_acquire) - (tail + 1));
+        if (lag < 0) {
+            // Empty, or the producer of the oldest sample has not finished writing it
+            break;
+        }
+        if (lag > 0) {
+            // Another reader took this sample first
+            tail = tail_.load(std::memory_order_relaxed);
+        } else if (tail_.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+            values[count++] = slot.value;
+            // Hands the slot back to the producers one lap ahead
+            slot.sequence.store(tail + CAPACITY, std::memory_order_release);
+            tail++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class FifoQueue
+ * @brief Register samples queued behind one FIFO pointer address (FC 0x18)
+ *
+ * A fixed ring buffer filled by the PLC tasks pushing samples from Lua and
+ * drained by readers with Read FIFO Queue. Every task can push to every
+ * queue and readers may run on any worker, so both ends claim slots with a
+ * compare-and-swap on their index, and each slot carries a sequence number
+ * that tells whose turn it is. Nothing takes a lock: a full queue drops the
+ * sample, and a reader stops at the first slot whose sample is still being
+ * written.
+ */
+class FifoQueue {
+public:
+    /// Samples held before new ones are dropped; a power of two
+    static constexpr size_t CAPACITY = 1024;
+
+    /// Samples returned by one Read FIFO Queue request
+    static constexpr size_t MAX_READ = 31;
+
+    FifoQueue();
+
+    /**
+     * @brief Queue a sample; safe to call from several tasks
+     *
+     * @param value Sample to queue
+     * @return false if the queue is full and the sample was dropped
+     */
+    bool push(uint16_t value);
+
+    /**
+     * @brief Remove the oldest samples; safe to call from several workers
+     *
+     * @param values Receives up to max samples, oldest first
+     * @param max Maximum number of samples to remove
+     * @return Number of samples removed
+     */
+    size_t pop(uint16_t* values, size_t max);
+
+private:
+    // A slot is free for the push at position p when sequence == p, and holds
+    // the sample for the pop at position p when sequence == p + 1
+    struct Slot {
+        std::atomic<size_t> sequence;
+        uint16_t value;
+    };
+
+    std::array<Slot, CAPACITY> ring_;           ///< Sample storage, indexed modulo CAPACITY
+    alignas(64) std::atomic<size_t> head_{0};   ///< Pushes claimed so far
+    alignas(64) std::atomic<size_t> tail_{0};   ///< Pops claimed so far
+};
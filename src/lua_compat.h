@@ -0,0 +1,37 @@
+#pragma once
+#include <lua.hpp>
+
+/**
+ * @file lua_compat.h
+ * @brief Lua C API differences between the supported backends
+ *
+ * The PLC builds against stock Lua 5.3/5.4 or, with SIMPLEPLC_WITH_LUAJIT,
+ * against LuaJIT, which implements the Lua 5.1 API. Sources include this
+ * header instead of lua.hpp and use the 5.3 names; on 5.1 they map onto
+ * the closest equivalent.
+ */
+
+#if LUA_VERSION_NUM < 502
+#ifndef LUA_OK
+#define LUA_OK 0
+#endif
+
+/// Length of a table without metamethods
+#define lua_rawlen(L, index) lua_objlen(L, (index))
+#endif
+
+#if LUA_VERSION_NUM < 503
+/**
+ * @brief Check whether a value is a number with an integral value
+ *
+ * Before 5.3 every number is a float, so this is the nearest equivalent of
+ * the integer subtype test.
+ */
+inline int lua_isinteger(lua_State* L, int index) {
+    if (lua_type(L, index) != LUA_TNUMBER) {
+        return 0;
+    }
+    lua_Number value = lua_tonumber(L, index);
+    return value == static_cast<lua_Number>(static_cast<lua_Integer>(value));
+}
+#endif
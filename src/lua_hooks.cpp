@@ -1,5 +1,13 @@
 #include "lua_hooks.h"
+#include <algorithm>
 #include <iostream>
+#include <vector>
+
+namespace {
+    bool is_bit_table(ProcessImage::Table table) {
+        return table == ProcessImage::Table::Coils || table == ProcessImage::Table::DiscreteInputs;
+    }
+}
 
 LuaHooks::LuaHooks(const std::string& script) {
     L = luaL_newstate();
@@ -49,54 +57,73 @@ bool LuaHooks::override_register(int address, uint16_t& value_out) {
     return true;
 }
 
-void LuaHooks::update_all_registers(modbus_mapping_t* mapping) {
-    if (!mapping) return;
+void LuaHooks::update_all_registers(ProcessImage& image) {
+    using Table = ProcessImage::Table;
 
-    // Update coils (0xxxx)
-    for (int i = 0; i < mapping->nb_bits; i++) {
+    // An override returned by Lua for one table index
+    struct Override {
+        Table table;
+        int index;
         uint16_t value;
-        if (override_register(i, value)) {
-            mapping->tab_bits[i] = value ? 1 : 0;
-        }
-    }
+    };
+    std::vector<Override> overrides;
 
-    // Update discrete inputs (1xxxx)
-    for (int i = 0; i < mapping->nb_input_bits; i++) {
-        uint16_t value;
-        if (override_register(10000 + i, value)) {
-            mapping->tab_input_bits[i] = value ? 1 : 0;
+    // The Lua calls run unlocked and only collect overrides. Only configured address
+    // blocks are visited; 1xxxx, 3xxxx and 4xxxx addresses are offset like their notation.
+    auto collect = [&](Table table, int offset) {
+        for (const auto& segment : image.layout(table).segments()) {
+            for (int addr = segment.start; addr < segment.start + segment.count; addr++) {
+                uint16_t value;
+                int index;
+                if (override_register(offset + addr, value) && image.translate(table, addr, 1, index)) {
+                    overrides.push_back({table, index, static_cast<uint16_t>(is_bit_table(table) ? value != 0 : value)});
+                }
+            }
         }
-    }
+    };
+    collect(Table::Coils, 0);
+    collect(Table::DiscreteInputs, 10000);
+    collect(Table::InputRegisters, 30000);
+    collect(Table::HoldingRegisters, 40000);
 
-    // Update input registers (3xxxx)
-    for (int i = 0; i < mapping->nb_input_registers; i++) {
-        uint16_t value;
-        if (override_register(30000 + i, value)) {
-            mapping->tab_input_registers[i] = value;
-        }
+    // Overrides usually repeat the current values; those must not open a transaction,
+    // or every update would look like a change to the read cache and OPC UA
+    auto differs = [](const auto& tables, const Override& entry) {
+        return is_bit_table(entry.table) ? tables.bit(entry.table, entry.index) != (entry.value != 0)
+                                         : tables.registers(entry.table)[entry.index] != entry.value;
+    };
+
+    bool changed = false;
+    image.read([&](const ProcessImage::Tables& tables) {
+        changed = std::any_of(overrides.begin(), overrides.end(),
+                              [&](const Override& entry) { return differs(tables, entry); });
+    });
+    if (!changed) {
+        return;
     }
 
-    // Update holding registers (4xxxx)
-    for (int i = 0; i < mapping->nb_registers; i++) {
-        uint16_t value;
-        if (override_register(40000 + i, value)) {
-            mapping->tab_registers[i] = value;
+    // One transaction for the whole update, writing only what still differs under the lock
+    ProcessImage::Transaction transaction(image);
+    for (const Override& entry : overrides) {
+        if (!differs(transaction, entry)) {
+            continue;
+        }
+        if (is_bit_table(entry.table)) {
+            auto bit = static_cast<uint8_t>(entry.value);
+            transaction.write_bits(entry.table, entry.index, 1, &bit);
+        } else {
+            *transaction.modify_registers(entry.table, entry.index, 1) = entry.value;
         }
     }
 }
 
-void LuaHooks::start_periodic_updates(modbus_mapping_t* mapping, int update_ms) {
+void LuaHooks::start_periodic_updates(ProcessImage& image, int update_ms) {
     if (running) {
         std::cerr << "[LuaHooks] Periodic updates already running" << std::endl;
         return;
     }
     
-    if (!mapping) {
-        std::cerr << "[LuaHooks] Cannot start updates with null mapping" << std::endl;
-        return;
-    }
-    
-    mb_mapping = mapping;
+    process_image = &image;
     running = true;
     
     try {
@@ -112,10 +139,7 @@ void LuaHooks::update_thread_func(int update_ms) {
     std::cout << "[LuaHooks] Update thread started" << std::endl;
     
     while (running) {
-        {
-            std::lock_guard<std::mutex> lock(mapping_mutex);
-            update_all_registers(mb_mapping);
-        }
+        update_all_registers(*process_image);
         
         // Sleep for the specified interval
         std::this_thread::sleep_for(std::chrono::milliseconds(update_ms));
@@ -61,7 +61,7 @@ int main(int argc, char* argv[]) {
     
     // Create and start OPC UA server
     std::cout << "[Main] Starting OPC UA server..." << std::endl;
-    std::unique_ptr<OpcUaServer> opcua_server(new OpcUaServer(modbus_server.get_mapping()));
+    std::unique_ptr<OpcUaServer> opcua_server(new OpcUaServer(modbus_server.get_image()));
     
     // Add tags from configuration
     const auto& tags = DeviceConfig::getTags();
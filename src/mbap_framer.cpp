@@ -0,0 +1,101 @@
+#include "platform.h"  // Include platform.h first for platform-specific definitions
+#include "mbap_framer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+void MbapFramer::compact() {
+    // Move the unconsumed tail to the front so the free space is contiguous
+    if (head_ > 0) {
+        size_t remaining = tail_ - head_;
+        if (remaining > 0) {
+            std::memmove(buffer_, buffer_ + head_, remaining);
+        }
+        head_ = 0;
+        tail_ = remaining;
+    }
+}
+
+size_t MbapFramer::append(const uint8_t* data, size_t length) {
+    compact();
+    size_t count = std::min(length, BUFFER_SIZE - tail_);
+    std::memcpy(buffer_ + tail_, data, count);
+    tail_ += count;
+    return count;
+}
+
+MbapFramer::ReceiveResult MbapFramer::receive(int socket) {
+    compact();
+    
+    if (tail_ == BUFFER_SIZE) {
+        // Only reachable if frames were not drained between reads
+        return ReceiveResult::WouldBlock;
+    }
+    
+    for (;;) {
+        ssize_t n = ::recv(socket, reinterpret_cast<char*>(buffer_ + tail_),
+                           static_cast<int>(BUFFER_SIZE - tail_), 0);
+        if (n > 0) {
+            tail_ += static_cast<size_t>(n);
+            return ReceiveResult::Data;
+        }
+        if (n == 0) {
+            return ReceiveResult::Closed;
+        }
+#ifdef _WIN32
+        int error = WSAGetLastError();
+        if (error == WSAEWOULDBLOCK) {
+            return ReceiveResult::WouldBlock;
+        }
+        if (error != WSAEINTR) {
+            return ReceiveResult::Error;
+        }
+#else
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return ReceiveResult::WouldBlock;
+        }
+        if (errno != EINTR) {
+            return ReceiveResult::Error;
+        }
+#endif
+    }
+}
+
+bool MbapFramer::has_frame() const {
+    size_t available = tail_ - head_;
+    if (malformed_ || available < MBAP_HEADER_LENGTH) {
+        return false;
+    }
+    const uint8_t* header = buffer_ + head_;
+    size_t pdu_length = static_cast<size_t>((header[4] << 8) | header[5]);
+    // Malformed headers are reported by next_frame()
+    return available >= 6 + pdu_length || pdu_length < 2 || pdu_length > MODBUS_TCP_MAX_ADU_LENGTH - 6
+           || header[2] != 0 || header[3] != 0;
+}
+
+bool MbapFramer::next_frame(const uint8_t*& frame, int& length) {
+    size_t available = tail_ - head_;
+    if (malformed_ || available < MBAP_HEADER_LENGTH) {
+        return false;
+    }
+    
+    const uint8_t* header = buffer_ + head_;
+    uint16_t protocol_id = static_cast<uint16_t>((header[2] << 8) | header[3]);
+    size_t pdu_length = static_cast<size_t>((header[4] << 8) | header[5]);
+    
+    // The length field counts the unit identifier plus at least a function code
+    if (protocol_id != 0 || pdu_length < 2 || pdu_length > MODBUS_TCP_MAX_ADU_LENGTH - 6) {
+        malformed_ = true;
+        return false;
+    }
+    
+    size_t frame_length = 6 + pdu_length;
+    if (available < frame_length) {
+        return false;
+    }
+    
+    frame = header;
+    length = static_cast<int>(frame_length);
+    head_ += frame_length;
+    return true;
+}
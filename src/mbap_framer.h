@@ -0,0 +1,101 @@
+#pragma once
+#include <modbus.h>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class MbapFramer
+ * @brief Per-connection receive buffer with an incremental Modbus TCP (MBAP) parser
+ * 
+ * Bytes are read from a non-blocking socket into a fixed buffer as they arrive.
+ * Complete ADUs are handed out one at a time; a partial header or PDU simply
+ * stays buffered until the rest of it is received, so a slow client never
+ * blocks the event loop.
+ */
+class MbapFramer {
+public:
+    /// Size of the MBAP header including the unit identifier
+    static constexpr size_t MBAP_HEADER_LENGTH = 7;
+    
+    /// Receive buffer capacity, large enough for several back-to-back ADUs
+    static constexpr size_t BUFFER_SIZE = 4 * MODBUS_TCP_MAX_ADU_LENGTH;
+    
+    /**
+     * @brief Result of a receive attempt
+     */
+    enum class ReceiveResult {
+        Data,        ///< New bytes were appended to the buffer
+        WouldBlock,  ///< The socket has no more data for now
+        Closed,      ///< The peer closed the connection
+        Error        ///< A socket error occurred
+    };
+    
+    /**
+     * @brief Read whatever the socket has available into the free buffer space
+     * 
+     * @param socket Non-blocking client socket
+     * @return Outcome of the read
+     */
+    ReceiveResult receive(int socket);
+    
+    /**
+     * @brief Append bytes that were received by other means (e.g. io_uring)
+     * 
+     * @param data Received bytes
+     * @param length Number of bytes available
+     * @return Number of bytes copied; less than length if the buffer is full
+     */
+    size_t append(const uint8_t* data, size_t length);
+    
+    /**
+     * @brief Get the next complete ADU from the buffer
+     * 
+     * The returned pointer stays valid until the next call to receive().
+     * 
+     * @param frame Set to the start of the ADU (MBAP header included)
+     * @param length Set to the total ADU length in bytes
+     * @return true if a complete ADU was available
+     */
+    bool next_frame(const uint8_t*& frame, int& length);
+
+    
+    /**
+     * @brief Check whether a complete ADU is buffered
+     * 
+     * @return true if next_frame() would succeed
+     */
+    bool has_frame() const;
+    
+    /**
+     * @brief Check whether the stream contained a malformed MBAP header
+     * 
+     * Once set, the byte stream cannot be resynchronised and the connection
+     * should be closed.
+     * 
+     * @return true if a protocol error was detected
+     */
+    bool malformed() const { return malformed_; }
+    
+    /**
+     * @brief Get the number of buffered bytes not yet returned as frames
+     * 
+     * @return Number of pending bytes
+     */
+    size_t pending() const { return tail_ - head_; }
+    
+    /**
+     * @brief Discard all buffered bytes so the framer can serve a new connection
+     */
+    void reset() { head_ = 0; tail_ = 0; malformed_ = false; }
+    
+private:
+    /**
+     * @brief Move unconsumed bytes to the start of the buffer
+     */
+    void compact();
+    
+    uint8_t buffer_[BUFFER_SIZE];  ///< Receive buffer
+    size_t head_ = 0;              ///< Start of the first unconsumed byte
+    size_t tail_ = 0;              ///< End of the received data
+    bool malformed_ = false;       ///< Set when an invalid header was seen
+};
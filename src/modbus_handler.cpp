@@ -1,25 +1,152 @@
 #include "platform.h"  // Include platform.h first for platform-specific definitions
 #include "modbus_handler.h"
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <random>
 #include "lua_hooks.h"
+#include "response_cache.h"
 #include "device_config.h"
 #include "server.h"
 
+namespace {
+    constexpr int MBAP_HEADER_LENGTH = 7;
+
+    // Not defined by libmodbus, which does not implement it
+    constexpr uint8_t FC_READ_FIFO_QUEUE = 0x18;
+
+    uint16_t read_u16(const uint8_t* data) {
+        return static_cast<uint16_t>((data[0] << 8) | data[1]);
+    }
+
+    void write_u16(uint8_t* data, uint16_t value) {
+        data[0] = static_cast<uint8_t>(value >> 8);
+        data[1] = static_cast<uint8_t>(value & 0xFF);
+    }
+
+    // Copies the transaction and unit ids and fills in the MBAP length for a PDU of pdu_length bytes
+    int finish_adu(const uint8_t* query, uint8_t* response, int pdu_length) {
+        response[0] = query[0];
+        response[1] = query[1];
+        response[2] = 0;
+        response[3] = 0;
+        write_u16(&response[4], static_cast<uint16_t>(pdu_length + 1));
+        response[6] = query[6];
+        return MBAP_HEADER_LENGTH + pdu_length;
+    }
+
+    int exception_response(const uint8_t* query, uint8_t* response, int code) {
+        response[7] = static_cast<uint8_t>(query[7] | 0x80);
+        response[8] = static_cast<uint8_t>(code);
+        return finish_adu(query, response, 2);
+    }
+
+    int read_bits(const uint8_t* query, uint8_t* response, const ProcessImage::Tables& tables,
+                  ProcessImage::Table table, const SegmentMap& layout) {
+        int addr = read_u16(&query[8]);
+        int count = read_u16(&query[10]);
+        int index;
+        if (count < 1 || count > MODBUS_MAX_READ_BITS) {
+            return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+        }
+        if (!layout.translate(addr, count, index)) {
+            return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+        }
+
+        // Packed LSB first on the wire, whatever the image's bit layout
+        int byte_count = (count + 7) / 8;
+        tables.pack_bits(table, index, count, &response[9]);
+        response[7] = query[7];
+        response[8] = static_cast<uint8_t>(byte_count);
+        return finish_adu(query, response, 2 + byte_count);
+    }
+
+    int read_registers(const uint8_t* query, uint8_t* response, const uint16_t* table, const SegmentMap& layout) {
+        int addr = read_u16(&query[8]);
+        int count = read_u16(&query[10]);
+        int index;
+        if (count < 1 || count > MODBUS_MAX_READ_REGISTERS) {
+            return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+        }
+        if (!layout.translate(addr, count, index)) {
+            return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+        }
+
+        uint8_t* out = &response[9];
+        for (int i = 0; i < count; i++) {
+            write_u16(&out[i * 2], table[index + i]);
+        }
+        response[7] = query[7];
+        response[8] = static_cast<uint8_t>(count * 2);
+        return finish_adu(query, response, 2 + count * 2);
+    }
+
+    // Answers a read from the cache while its range is unchanged, otherwise encodes it with encode(tables)
+    template <typename Encode>
+    int cached_read(const uint8_t* query, uint8_t* response, ProcessImage& image, ResponseCache* cache,
+                    ProcessImage::Table table, Encode encode) {
+        int count = read_u16(&query[10]);
+        int index;
+        bool cacheable = cache && image.translate(table, read_u16(&query[8]), count, index);
+        if (cacheable) {
+            int pdu_length = cache->lookup(query, image, table, index, count, &response[7]);
+            if (pdu_length > 0) {
+                return finish_adu(query, response, pdu_length);
+            }
+        }
+
+        // Taken first, so a change published during the encode invalidates the entry
+        uint64_t generation = image.generation();
+        int length = 0;
+        image.read([&](const ProcessImage::Tables& tables) {
+            length = encode(tables);
+        });
+        if (cacheable && !(response[7] & 0x80)) {
+            cache->store(query, generation, table, index, count, &response[7], length - MBAP_HEADER_LENGTH);
+        }
+        return length;
+    }
+
+    // Drains up to 31 samples of a FIFO queue; the response carries the byte count, the sample count and the samples
+    int read_fifo(const uint8_t* query, int rc, ProcessImage& image, uint8_t* response) {
+        if (rc < MBAP_HEADER_LENGTH + 3) {
+            return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+        }
+        FifoQueue* fifo = image.fifo(read_u16(&query[8]));
+        if (!fifo) {
+            return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+        }
+        uint16_t samples[FifoQueue::MAX_READ];
+        auto count = static_cast<int>(fifo->pop(samples, FifoQueue::MAX_READ));
+        response[7] = query[7];
+        write_u16(&response[8], static_cast<uint16_t>(2 + count * 2));
+        write_u16(&response[10], static_cast<uint16_t>(count));
+        for (int i = 0; i < count; i++) {
+            write_u16(&response[12 + i * 2], samples[i]);
+        }
+        return finish_adu(query, response, 5 + count * 2);
+    }
+
+    // Write responses echo the function code, address and value/count of the request
+    int echo_response(const uint8_t* query, uint8_t* response) {
+        std::memcpy(&response[7], &query[7], 5);
+        return finish_adu(query, response, 5);
+    }
+}
+
 // Global LuaHooks instance used by ModbusHandler
 static std::unique_ptr<LuaHooks> hooks;
-// Reference to the ModbusServer for locking (will be set in init_lua_hooks)
+// Reference to the owning ModbusServer (will be set in init_lua_hooks)
 static ModbusServer* server_instance = nullptr;
 
 // Initialize and start Lua hooks
-void ModbusHandler::init_lua_hooks(modbus_mapping_t* mapping, ModbusServer* server) {
+void ModbusHandler::init_lua_hooks(ProcessImage& image, ModbusServer* server) {
     server_instance = server;
     
     if (!hooks) {
         try {
             hooks = std::make_unique<LuaHooks>("world.plc");
-            hooks->start_periodic_updates(mapping, 100); // Update every 100ms
+            hooks->start_periodic_updates(image, 100); // Update every 100ms
             std::cout << "[Modbus] Initialized Lua hooks with world.plc" << std::endl;
         } catch (const std::exception& e) {
             std::cerr << "[Modbus] Failed to initialize Lua hooks: " << e.what() << std::endl;
@@ -27,7 +154,7 @@ void ModbusHandler::init_lua_hooks(modbus_mapping_t* mapping, ModbusServer* serv
     }
 }
 
-void ModbusHandler::send_report_slave_id(int socket, modbus_t*, const uint8_t* req, int) {
+int ModbusHandler::build_report_slave_id(const uint8_t* req, int, uint8_t* response) {
     try {
         // Get the device configuration
         const auto& config = DeviceConfig::getDeviceInfo();
@@ -40,8 +167,6 @@ void ModbusHandler::send_report_slave_id(int socket, modbus_t*, const uint8_t* r
             std::cerr << "[Modbus] Device name too long, truncating" << std::endl;
             name_len = 240;
         }
-        
-        uint8_t response[256] = {0};    
 
         // Copy header fields
         std::memcpy(response, req, 6);  // TID, PID
@@ -58,27 +183,16 @@ void ModbusHandler::send_report_slave_id(int socket, modbus_t*, const uint8_t* r
         uint16_t len = 3 + response[8];
         response[4] = static_cast<uint8_t>((len >> 8) & 0xFF);
         response[5] = static_cast<uint8_t>(len & 0xFF);
-        int total = 6 + len;
-
-        // Send the response
-        if (::send(socket, reinterpret_cast<const char*>(response), static_cast<size_t>(total), 0) < 0) {
-#ifdef _WIN32
-            std::cerr << "[Modbus] send_report_slave_id failed: " << WSAGetLastError() << std::endl;
-#else
-            std::cerr << "[Modbus] send_report_slave_id failed: " << strerror(errno) << std::endl;
-#endif
-        } else {
-            std::cout << "[Modbus] Sent Report Slave ID response (" << total << " bytes)" << std::endl;
-        }
+        return 6 + len;
     } catch (const std::exception& e) {
-        std::cerr << "[Modbus] Error in send_report_slave_id: " << e.what() << std::endl;
+        std::cerr << "[Modbus] Error in build_report_slave_id: " << e.what() << std::endl;
+        return 0;
     }
 }
 
-void ModbusHandler::send_read_device_id(int socket, modbus_t*, const uint8_t* req, int) {
+int ModbusHandler::build_read_device_id(const uint8_t* req, int, uint8_t* response) {
     try {
         // Device identification response (MEI Type 0x0E)
-        uint8_t response[256] = {0};
         
         // Copy header fields
         std::memcpy(response, req, 6);
@@ -110,113 +224,187 @@ void ModbusHandler::send_read_device_id(int socket, modbus_t*, const uint8_t* re
         uint16_t data_len = static_cast<uint16_t>((16 + len) - 6);
         response[4] = static_cast<uint8_t>((data_len >> 8) & 0xFF);
         response[5] = static_cast<uint8_t>(data_len & 0xFF);
-        
-        // Send the response
-        if (::send(socket, reinterpret_cast<const char*>(response), static_cast<size_t>(16 + len), 0) < 0) {
-#ifdef _WIN32
-            std::cerr << "[Modbus] send_read_device_id failed: " << WSAGetLastError() << std::endl;
-#else
-            std::cerr << "[Modbus] send_read_device_id failed: " << strerror(errno) << std::endl;
-#endif
-        } else {
-            std::cout << "[Modbus] Sent Read Device ID response (" << (16 + len) << " bytes)" << std::endl;
-        }
+        return static_cast<int>(16 + len);
     } catch (const std::exception& e) {
-        std::cerr << "[Modbus] Error in send_read_device_id: " << e.what() << std::endl;
+        std::cerr << "[Modbus] Error in build_read_device_id: " << e.what() << std::endl;
+        return 0;
     }
 }
 
-void ModbusHandler::handle_standard_function(modbus_t* /* ctx */, const uint8_t* query, int /* rc */, modbus_mapping_t* mapping) {
-    try {
-        // Make sure Lua hooks are initialized
-        if (!hooks) {
-            if (server_instance) {
-                init_lua_hooks(mapping, server_instance);
-            } else {
-                init_lua_hooks(mapping, nullptr);
+int ModbusHandler::build_exception_response(const uint8_t* query, int code, uint8_t* response) {
+    return exception_response(query, response, code);
+}
+
+bool ModbusHandler::encodes_natively(uint8_t function) {
+    switch (function) {
+        case MODBUS_FC_READ_COILS:
+        case MODBUS_FC_READ_DISCRETE_INPUTS:
+        case MODBUS_FC_READ_HOLDING_REGISTERS:
+        case MODBUS_FC_READ_INPUT_REGISTERS:
+        case MODBUS_FC_WRITE_SINGLE_COIL:
+        case MODBUS_FC_WRITE_SINGLE_REGISTER:
+        case MODBUS_FC_WRITE_MULTIPLE_COILS:
+        case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+        case MODBUS_FC_MASK_WRITE_REGISTER:
+        case MODBUS_FC_WRITE_AND_READ_REGISTERS:
+        case FC_READ_FIFO_QUEUE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+int ModbusHandler::build_standard_response(const uint8_t* query, int rc, ProcessImage& image, uint8_t* response,
+                                           ResponseCache* cache) {
+    using Table = ProcessImage::Table;
+    uint8_t function_code = query[7];
+    if (!encodes_natively(function_code)) {
+        return 0;
+    }
+    if (function_code == FC_READ_FIFO_QUEUE) {
+        return read_fifo(query, rc, image, response);
+    }
+    // Every supported request carries at least an address and a count or value
+    if (rc < MBAP_HEADER_LENGTH + 5) {
+        return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+    }
+
+    int addr = read_u16(&query[8]);
+    int index;
+
+    switch (function_code) {
+        case MODBUS_FC_READ_COILS: {            // FC 1
+            return cached_read(query, response, image, cache, Table::Coils, [&](const ProcessImage::Tables& tables) {
+                return read_bits(query, response, tables, Table::Coils, image.layout(Table::Coils));
+            });
+        }
+
+        case MODBUS_FC_READ_DISCRETE_INPUTS: {  // FC 2
+            return cached_read(query, response, image, cache, Table::DiscreteInputs, [&](const ProcessImage::Tables& tables) {
+                return read_bits(query, response, tables, Table::DiscreteInputs, image.layout(Table::DiscreteInputs));
+            });
+        }
+
+        case MODBUS_FC_READ_HOLDING_REGISTERS: { // FC 3
+            return cached_read(query, response, image, cache, Table::HoldingRegisters, [&](const ProcessImage::Tables& tables) {
+                return read_registers(query, response, tables.registers(Table::HoldingRegisters), image.layout(Table::HoldingRegisters));
+            });
+        }
+
+        case MODBUS_FC_READ_INPUT_REGISTERS: {  // FC 4
+            return cached_read(query, response, image, cache, Table::InputRegisters, [&](const ProcessImage::Tables& tables) {
+                return read_registers(query, response, tables.registers(Table::InputRegisters), image.layout(Table::InputRegisters));
+            });
+        }
+
+        case MODBUS_FC_WRITE_SINGLE_COIL: {     // FC 5
+            uint16_t value = read_u16(&query[10]);
+            if (!image.translate(Table::Coils, addr, 1, index)) {
+                return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
             }
+            if (value != 0xFF00 && value != 0x0000) {
+                return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+            }
+            uint8_t bit = value ? 1 : 0;
+            ProcessImage::Transaction transaction(image);
+            transaction.write_bits(Table::Coils, index, 1, &bit);
+            return echo_response(query, response);
         }
-        
-        // Process only write operations - the reply will be handled separately
-        uint8_t function_code = query[7];
-        
-        // Only handle write operations, skip read operations
-        switch (function_code) {
-            case MODBUS_FC_WRITE_SINGLE_COIL: {       // FC 5
-                int addr = (query[8] << 8) | query[9];
-                if (addr >= 0 && addr < mapping->nb_bits) {
-                    mapping->tab_bits[addr] = (query[10] == 0xFF) ? 1 : 0;
-                    std::cout << "[Modbus] Write coil " << addr << " = " 
-                              << (mapping->tab_bits[addr] ? "ON" : "OFF") << std::endl;
-                } else {
-                    std::cerr << "[Modbus] Address out of range for write coil: " << addr << std::endl;
-                }
-                break;
+
+        case MODBUS_FC_WRITE_SINGLE_REGISTER: { // FC 6
+            if (!image.translate(Table::HoldingRegisters, addr, 1, index)) {
+                return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
             }
+            ProcessImage::Transaction transaction(image);
+            *transaction.modify_registers(Table::HoldingRegisters, index, 1) = read_u16(&query[10]);
+            return echo_response(query, response);
+        }
 
-            case MODBUS_FC_WRITE_SINGLE_REGISTER: {   // FC 6
-                int addr = (query[8] << 8) | query[9];
-                if (addr >= 0 && addr < mapping->nb_registers) {
-                    mapping->tab_registers[addr] = static_cast<uint16_t>((query[10] << 8) | query[11]);
-                    std::cout << "[Modbus] Write register " << addr << " = " 
-                              << mapping->tab_registers[addr] << std::endl;
-                } else {
-                    std::cerr << "[Modbus] Address out of range for write register: " << addr << std::endl;
-                }
-                break;
+        case MODBUS_FC_WRITE_MULTIPLE_COILS: {  // FC 15
+            int count = read_u16(&query[10]);
+            int byte_count = rc > MBAP_HEADER_LENGTH + 5 ? query[12] : 0;
+            if (count < 1 || count > MODBUS_MAX_WRITE_BITS || byte_count * 8 < count ||
+                MBAP_HEADER_LENGTH + 6 + byte_count > rc) {
+                return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
             }
+            if (!image.translate(Table::Coils, addr, count, index)) {
+                return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+            }
+            const uint8_t* values = &query[13];
+            ProcessImage::Transaction transaction(image);
+            transaction.write_packed_bits(Table::Coils, index, count, values);
+            return echo_response(query, response);
+        }
 
-            case MODBUS_FC_WRITE_MULTIPLE_COILS: {    // FC 15
-                int addr = (query[8] << 8) | query[9];
-                int count = (query[10] << 8) | query[11];
-                uint8_t byte_count = query[12];
-                
-                if (addr + count > mapping->nb_bits) {
-                    std::cerr << "[Modbus] Address range out of bounds for write multiple coils" << std::endl;
-                } else {
-                    for (int i = 0; i < count; ++i) {
-                        int byte_index = i / 8;
-                        int bit_index = i % 8;
-                        if (byte_index < byte_count) {
-                            mapping->tab_bits[addr + i] = (query[13 + byte_index] >> bit_index) & 0x01;
-                        }
-                    }
-                    std::cout << "[Modbus] Write " << count << " coils starting at " << addr << std::endl;
-                }
-                break;
+        case MODBUS_FC_WRITE_MULTIPLE_REGISTERS: { // FC 16
+            int count = read_u16(&query[10]);
+            int byte_count = rc > MBAP_HEADER_LENGTH + 5 ? query[12] : 0;
+            if (count < 1 || count > MODBUS_MAX_WRITE_REGISTERS || byte_count != count * 2 ||
+                MBAP_HEADER_LENGTH + 6 + byte_count > rc) {
+                return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+            }
+            if (!image.translate(Table::HoldingRegisters, addr, count, index)) {
+                return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
             }
+            const uint8_t* values = &query[13];
+            ProcessImage::Transaction transaction(image);
+            uint16_t* registers = transaction.modify_registers(Table::HoldingRegisters, index, count);
+            for (int i = 0; i < count; i++) {
+                registers[i] = read_u16(&values[i * 2]);
+            }
+            return echo_response(query, response);
+        }
 
-            case MODBUS_FC_WRITE_MULTIPLE_REGISTERS: { // FC 16
-                int addr = (query[8] << 8) | query[9];
-                int count = (query[10] << 8) | query[11];
-                uint8_t byte_count = query[12];
-                
-                if (addr + count > mapping->nb_registers) {
-                    std::cerr << "[Modbus] Address range out of bounds for write multiple registers" << std::endl;
-                } else {
-                    for (int i = 0; i < count && (i * 2) < byte_count; ++i) {
-                        mapping->tab_registers[addr + i] = static_cast<uint16_t>((query[13 + i * 2] << 8) | query[14 + i * 2]);
-                    }
-                    std::cout << "[Modbus] Write " << count << " registers starting at " << addr << std::endl;
-                }
-                break;
+        case MODBUS_FC_MASK_WRITE_REGISTER: {   // FC 22
+            if (rc < MBAP_HEADER_LENGTH + 7) {
+                return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
             }
-                
-            // Read functions just need a reply, no preprocessing needed
-            case MODBUS_FC_READ_COILS:              // FC 1
-            case MODBUS_FC_READ_DISCRETE_INPUTS:    // FC 2
-            case MODBUS_FC_READ_HOLDING_REGISTERS:  // FC 3
-            case MODBUS_FC_READ_INPUT_REGISTERS:    // FC 4
-                // Nothing to do for read functions
-                break;
-                
-            default:
-                std::cout << "[Modbus] Received unhandled function code: 0x" 
-                         << std::hex << static_cast<int>(function_code) << std::dec << std::endl;
-                break;
+            if (!image.translate(Table::HoldingRegisters, addr, 1, index)) {
+                return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+            }
+            uint16_t and_mask = read_u16(&query[10]);
+            uint16_t or_mask = read_u16(&query[12]);
+            // Read-modify-write inside one transaction, so no other writer can interleave
+            ProcessImage::Transaction transaction(image);
+            uint16_t* reg = transaction.modify_registers(Table::HoldingRegisters, index, 1);
+            *reg = static_cast<uint16_t>((*reg & and_mask) | (or_mask & ~and_mask));
+            std::memcpy(&response[7], &query[7], 7);
+            return finish_adu(query, response, 7);
         }
-    } catch (const std::exception& e) {
-        std::cerr << "[Modbus] Error in handle_standard_function: " << e.what() << std::endl;
-        throw; // Rethrow to allow the caller to handle it
+
+        case MODBUS_FC_WRITE_AND_READ_REGISTERS: { // FC 23
+            int read_count = read_u16(&query[10]);
+            int write_addr = rc >= MBAP_HEADER_LENGTH + 10 ? read_u16(&query[12]) : 0;
+            int write_count = rc >= MBAP_HEADER_LENGTH + 10 ? read_u16(&query[14]) : 0;
+            int byte_count = rc > MBAP_HEADER_LENGTH + 9 ? query[16] : 0;
+            if (read_count < 1 || read_count > MODBUS_MAX_WR_READ_REGISTERS ||
+                write_count < 1 || write_count > MODBUS_MAX_WR_WRITE_REGISTERS ||
+                byte_count != write_count * 2 || MBAP_HEADER_LENGTH + 10 + byte_count > rc) {
+                return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+            }
+            int write_index;
+            if (!image.translate(Table::HoldingRegisters, addr, read_count, index) ||
+                !image.translate(Table::HoldingRegisters, write_addr, write_count, write_index)) {
+                return exception_response(query, response, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS);
+            }
+            // The write is applied before the read, both in one transaction
+            const uint8_t* values = &query[17];
+            ProcessImage::Transaction transaction(image);
+            uint16_t* registers = transaction.modify_registers(Table::HoldingRegisters, write_index, write_count);
+            for (int i = 0; i < write_count; i++) {
+                registers[i] = read_u16(&values[i * 2]);
+            }
+            const uint16_t* table = transaction.registers(Table::HoldingRegisters);
+            uint8_t* out = &response[9];
+            for (int i = 0; i < read_count; i++) {
+                write_u16(&out[i * 2], table[index + i]);
+            }
+            response[7] = query[7];
+            response[8] = static_cast<uint8_t>(read_count * 2);
+            return finish_adu(query, response, 2 + read_count * 2);
+        }
+
+        default:
+            return 0;
     }
 }
@@ -2,9 +2,11 @@
 #include <modbus.h>
 #include <cstdint>
 #include <memory>
+#include "process_image.h"
 
-// Forward declaration
+// Forward declarations
 class ModbusServer;
+class ResponseCache;
 
 /**
  * @class ModbusHandler
@@ -18,48 +20,67 @@ public:
     /**
      * @brief Initialize Lua hooks for simulation
      * 
-     * @param mapping Modbus data mapping to update periodically
-     * @param server Pointer to the ModbusServer instance for mutex locking
+     * @param image Process image to update periodically
+     * @param server Pointer to the owning ModbusServer instance
      */
-    static void init_lua_hooks(modbus_mapping_t* mapping, ModbusServer* server = nullptr);
+    static void init_lua_hooks(ProcessImage& image, ModbusServer* server = nullptr);
     
     /**
-     * @brief Handles the Report Slave ID function (0x11)
+     * @brief Builds the response to the Report Slave ID function (0x11)
      * 
-     * @param socket Client socket descriptor
-     * @param ctx Modbus context
      * @param req Request data
      * @param len Length of request
+     * @param response Output buffer of at least MODBUS_TCP_MAX_ADU_LENGTH bytes
+     * @return Length of the response, 0 on error
      */
-    static void send_report_slave_id(int socket, modbus_t* ctx, const uint8_t* req, int len);
+    static int build_report_slave_id(const uint8_t* req, int len, uint8_t* response);
     
     /**
-     * @brief Handles the Read Device Identification function (0x2B/0x0E)
+     * @brief Builds the response to the Read Device Identification function (0x2B/0x0E)
      * 
-     * @param socket Client socket descriptor
-     * @param ctx Modbus context
      * @param req Request data
      * @param len Length of request
+     * @param response Output buffer of at least MODBUS_TCP_MAX_ADU_LENGTH bytes
+     * @return Length of the response, 0 on error
      */
-    static void send_read_device_id(int socket, modbus_t* ctx, const uint8_t* req, int len);
+    static int build_read_device_id(const uint8_t* req, int len, uint8_t* response);
     
     /**
-     * @brief Handles standard Modbus functions (read/write registers & bits)
+     * @brief Check whether build_standard_response() answers a function code
      * 
-     * Processes standard Modbus functions like:
-     * - Read Coils (0x01)
-     * - Read Discrete Inputs (0x02)
-     * - Read Holding Registers (0x03)
-     * - Read Input Registers (0x04)
-     * - Write Single Coil (0x05)
-     * - Write Single Register (0x06)
-     * - Write Multiple Coils (0x0F)
-     * - Write Multiple Registers (0x10)
+     * @param function Modbus function code
+     * @return true if the response is encoded natively, false if the function is answered with Illegal Function
+     */
+    static bool encodes_natively(uint8_t function);
+    
+    /**
+     * @brief Builds the response to a standard read/write function straight from the process image
+     * 
+     * Validates the request the way modbus_reply() does, applies writes and
+     * serializes the reply, or an exception response, in a single pass with
+     * no heap allocation. Reads copy out of the image without locking;
+     * writes are one image transaction. Mask Write (0x16) and Read/Write
+     * Multiple (0x17) run their read and write parts in that same
+     * transaction, so no other writer can interleave. Read responses are served from
+     * and added to the cache when one is given.
+     * 
+     * @param query Complete request ADU, MBAP header included
+     * @param rc Length of the request
+     * @param image Process image
+     * @param response Output buffer of at least MODBUS_TCP_MAX_ADU_LENGTH bytes
+     * @param cache Encoded read responses, or nullptr to always encode
+     * @return Length of the response, 0 if the function is not encoded natively
+     */
+    static int build_standard_response(const uint8_t* query, int rc, ProcessImage& image, uint8_t* response,
+                                       ResponseCache* cache = nullptr);
+    
+    /**
+     * @brief Builds an exception response to a request
      * 
-     * @param ctx Modbus context
-     * @param query Request data
-     * @param rc Length of request
-     * @param mapping Modbus data mapping
+     * @param query Complete request ADU, MBAP header included
+     * @param code Modbus exception code, e.g. MODBUS_EXCEPTION_SLAVE_OR_SERVER_BUSY
+     * @param response Output buffer of at least MODBUS_TCP_MAX_ADU_LENGTH bytes
+     * @return Length of the response
      */
-    static void handle_standard_function(modbus_t* ctx, const uint8_t* query, int rc, modbus_mapping_t* mapping);
+    static int build_exception_response(const uint8_t* query, int code, uint8_t* response);
 };
@@ -3,8 +3,20 @@
 #include <signal.h>
 #include "device_config.h"
 
-OpcUaServer::OpcUaServer(modbus_mapping_t* mapping) 
-    : mb_mapping(mapping), running(false) {
+namespace {
+    ProcessImage::Table tag_table(TagInfo::Type type) {
+        switch (type) {
+            case TagInfo::Type::Coil: return ProcessImage::Table::Coils;
+            case TagInfo::Type::DiscreteInput: return ProcessImage::Table::DiscreteInputs;
+            case TagInfo::Type::HoldingRegister: return ProcessImage::Table::HoldingRegisters;
+            case TagInfo::Type::InputRegister: break;
+        }
+        return ProcessImage::Table::InputRegisters;
+    }
+}
+
+OpcUaServer::OpcUaServer(ProcessImage& image) 
+    : process_image(image), running(false) {
     // Get the OPC UA server configuration
     const auto& config = DeviceConfig::getOpcUaConfig();
     
@@ -123,6 +135,7 @@ void OpcUaServer::addTag(const std::string& name, uint16_t modbusAddress, TagInf
 
     if (running) {
         addVariable(tag);
+        synced = false;
     }
 }
 
@@ -201,7 +214,19 @@ void OpcUaServer::updateValues() {
         //std::cout << "[OPC UA] Updating tag values (update #" << update_counter << ")" << std::endl;
     }
     
+    // Taken first: anything published during the update is pushed again next time
+    uint64_t generation = process_image.generation();
+    bool push_all = !synced.exchange(true);
+    
     for (const auto& tag : tags) {
+        // Tags outside the blocks changed since the last update already hold their value
+        ProcessImage::Table table = tag_table(tag.second.type);
+        int index;
+        if (!push_all && (!process_image.translate(table, tag.second.modbusAddress, 1, index) ||
+                          !process_image.changed_since(table, index, 1, synced_generation))) {
+            continue;
+        }
+        
         char* name = strdup(tag.first.c_str());
         
         UA_NodeId nodeId;
@@ -214,28 +239,34 @@ void OpcUaServer::updateValues() {
         
         switch (tag.second.type) {
             case TagInfo::Type::Coil: {
-                UA_Boolean boolValue = mb_mapping->tab_bits[tag.second.modbusAddress];
+                bool bit = false;
+                process_image.read_bit(ProcessImage::Table::Coils, tag.second.modbusAddress, bit);
+                UA_Boolean boolValue = bit;
                 UA_Variant_setScalar(&value, &boolValue, &UA_TYPES[UA_TYPES_BOOLEAN]);
                 
 
                 break;
             }
             case TagInfo::Type::DiscreteInput: {
-                UA_Boolean boolValue = mb_mapping->tab_input_bits[tag.second.modbusAddress];
+                bool bit = false;
+                process_image.read_bit(ProcessImage::Table::DiscreteInputs, tag.second.modbusAddress, bit);
+                UA_Boolean boolValue = bit;
                 UA_Variant_setScalar(&value, &boolValue, &UA_TYPES[UA_TYPES_BOOLEAN]);
                 
 
                 break;
             }
             case TagInfo::Type::HoldingRegister: {
-                UA_UInt16 intValue = mb_mapping->tab_registers[tag.second.modbusAddress];
+                UA_UInt16 intValue = 0;
+                process_image.read_register(ProcessImage::Table::HoldingRegisters, tag.second.modbusAddress, intValue);
                 UA_Variant_setScalar(&value, &intValue, &UA_TYPES[UA_TYPES_UINT16]);
                 
 
                 break;
             }
             case TagInfo::Type::InputRegister: {
-                UA_UInt16 intValue = mb_mapping->tab_input_registers[tag.second.modbusAddress];
+                UA_UInt16 intValue = 0;
+                process_image.read_register(ProcessImage::Table::InputRegisters, tag.second.modbusAddress, intValue);
                 UA_Variant_setScalar(&value, &intValue, &UA_TYPES[UA_TYPES_UINT16]);
                 
 
@@ -247,6 +278,7 @@ void OpcUaServer::updateValues() {
         UA_NodeId_clear(&nodeId);
         free(name);
     }
+    synced_generation = generation;
 }
 
 void OpcUaServer::writeVariableCallback(UA_Server * /* server */,
@@ -255,7 +287,7 @@ void OpcUaServer::writeVariableCallback(UA_Server * /* server */,
                                      const UA_NumericRange * /* range */, const UA_DataValue *data) {
     
     OpcUaServer* self = static_cast<OpcUaServer*>(nodeContext);
-    if (!self || !self->mb_mapping) {
+    if (!self) {
         return; // Error: bad internal state
     }
     
@@ -276,7 +308,7 @@ void OpcUaServer::writeVariableCallback(UA_Server * /* server */,
             // Only allow writing to coils (output bits)
             if (data->value.type == &UA_TYPES[UA_TYPES_BOOLEAN]) {
                 UA_Boolean value = *static_cast<UA_Boolean*>(data->value.data);
-                self->mb_mapping->tab_bits[tag->modbusAddress] = value;
+                self->process_image.write_bit(ProcessImage::Table::Coils, tag->modbusAddress, value);
                 //std::cout << "[OPC UA] Client wrote " << (value ? "TRUE" : "FALSE") 
                 //          << " to coil: " << tag->name << std::endl;
             }
@@ -287,7 +319,7 @@ void OpcUaServer::writeVariableCallback(UA_Server * /* server */,
             // Only allow writing to holding registers
             if (data->value.type == &UA_TYPES[UA_TYPES_UINT16]) {
                 UA_UInt16 value = *static_cast<UA_UInt16*>(data->value.data);
-                self->mb_mapping->tab_registers[tag->modbusAddress] = value;
+                self->process_image.write_register(ProcessImage::Table::HoldingRegisters, tag->modbusAddress, value);
                 //std::cout << "[OPC UA] Client wrote " << value 
                 //          << " to holding register: " << tag->name << std::endl;
             }
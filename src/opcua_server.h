@@ -2,7 +2,7 @@
 
 #include <open62541/server.h>
 #include <open62541/server_config_default.h>
-#include <modbus.h>
+#include "process_image.h"
 #include <string>
 #include <map>
 #include <thread>
@@ -23,7 +23,7 @@ struct TagInfo {
 
 class OpcUaServer {
 public:
-    OpcUaServer(modbus_mapping_t* mapping);
+    OpcUaServer(ProcessImage& image);
     ~OpcUaServer();
     
     bool start();
@@ -33,9 +33,11 @@ public:
     
 private:
     UA_Server* server;
-    modbus_mapping_t* mb_mapping;
+    ProcessImage& process_image;
     std::map<std::string, TagInfo> tags;
     std::atomic<bool> running;
+    std::atomic<bool> synced{false};   // False until every tag has been pushed once
+    uint64_t synced_generation = 0;    // Image generation the pushed values are up to date with
     std::thread event_loop_thread;
     
     UA_NodeId addVariable(const TagInfo& tag);
@@ -163,8 +163,13 @@ namespace Platform {
     std::string getExecutableDir();
 }
 
+#include <chrono>
+#include <thread>
+
 // Unix-specific includes
 #ifndef _WIN32
+    #include <errno.h>
+    #include <time.h>
     #include <unistd.h>
     #include <termios.h>
     #include <sys/select.h>
@@ -172,6 +177,11 @@ namespace Platform {
     #include <fcntl.h>       // For F_GETFL, F_SETFL, etc.
 #endif
 
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>       // For cpu_set_t and CPU affinity
+#endif
+
 // Platform-independent terminal functions
 namespace platform {
     // Forward declaration of platform-specific data
@@ -235,6 +245,61 @@ namespace platform {
 #endif
     }
 
+    // Monotonic time in nanoseconds, the clock sleep_until_ns() measures deadlines against
+    inline uint64_t monotonic_ns() {
+#ifdef __linux__
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + static_cast<uint64_t>(now.tv_nsec);
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    // Sleep until an absolute monotonic_ns() deadline, so time spent awake does not add up as drift
+    inline void sleep_until_ns(uint64_t deadline_ns) {
+#ifdef __linux__
+        struct timespec deadline;
+        deadline.tv_sec = static_cast<time_t>(deadline_ns / 1000000000ULL);
+        deadline.tv_nsec = static_cast<long>(deadline_ns % 1000000000ULL);
+        // Returns the error number itself; EINTR only means a signal arrived first
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+        }
+#else
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(deadline_ns))));
+#endif
+    }
+
+    // Pin the calling thread to a single CPU; returns false if unsupported or refused
+    inline bool pin_current_thread(int cpu) {
+#ifdef __linux__
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            return false;
+        }
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(static_cast<size_t>(cpu), &cpuset);
+        return pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0;
+#else
+        (void)cpu;
+        return false;
+#endif
+    }
+
+    // Give the calling thread a fixed real-time priority (SCHED_FIFO); returns false if unsupported or refused
+    inline bool set_realtime_priority(int priority) {
+#ifdef __linux__
+        struct sched_param param{};
+        param.sched_priority = priority;
+        return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#else
+        (void)priority;
+        return false;
+#endif
+    }
+
 #ifdef _WIN32
     // Windows-specific socket initialization
     class WinSockInit {
@@ -1,9 +1,13 @@
 #include "plc_logic.h"
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <iostream>
 #include <mutex>
+#include <new>
 #include <string>
 #include "platform.h"
+#include "bit_kernels.h"
 #include "device_config.h"
 
 // These constants were likely part of an earlier implementation or for future use
@@ -16,10 +20,254 @@ constexpr std::chrono::milliseconds SCAN_TIME(100);
 */
 
 std::atomic<bool> PlcLogic::running = false;
-std::thread PlcLogic::thread;
-modbus_mapping_t* PlcLogic::mb_mapping = nullptr;
-std::timed_mutex PlcLogic::mb_mutex;
-lua_State* PlcLogic::lua_state = nullptr;
+ProcessImage* PlcLogic::process_image = nullptr;
+std::vector<std::unique_ptr<PlcLogic::Task>> PlcLogic::tasks;
+#ifdef SIMPLEPLC_HAVE_LUAJIT
+std::array<std::vector<int32_t>, 4> PlcLogic::address_maps;
+#endif
+
+namespace {
+    // Scan image index of a Lua-supplied Modbus address; false if it is not mapped
+    bool scan_index(const ProcessImage* image, ProcessImage::Table table, lua_Integer addr, size_t& index) {
+        int mapped;
+        if (addr < 0 || addr >= SegmentMap::ADDRESS_SPACE ||
+            !image->translate(table, static_cast<int>(addr), 1, mapped)) {
+            return false;
+        }
+        index = static_cast<size_t>(mapped);
+        return true;
+    }
+
+    // Register value assigned through an image proxy: a whole number that fits 16 bits, signed or unsigned
+    bool register_value(lua_State* L, int arg, uint16_t& value) {
+        if (lua_type(L, arg) != LUA_TNUMBER) {
+            return false;
+        }
+        lua_Number number = lua_tonumber(L, arg);
+        if (number != std::floor(number) || number < -32768 || number > 65535) {
+            return false;
+        }
+        value = static_cast<uint16_t>(static_cast<int32_t>(number));
+        return true;
+    }
+
+    // Scan image index of a Lua-supplied address range inside one address block; false if any address is unmapped
+    bool scan_range(const ProcessImage* image, ProcessImage::Table table, lua_Integer addr, lua_Integer count, size_t& index) {
+        int mapped;
+        if (addr < 0 || count < 1 || addr + count > SegmentMap::ADDRESS_SPACE ||
+            !image->translate(table, static_cast<int>(addr), static_cast<int>(count), mapped)) {
+            return false;
+        }
+        index = static_cast<size_t>(mapped);
+        return true;
+    }
+
+    // Returns count entries from an address as a 1-based array, or nil if the range is not mapped
+    template <typename T>
+    int read_range(lua_State* L, const ProcessImage* image, ProcessImage::Table table, const std::vector<T>& values) {
+        lua_Integer addr = luaL_checkinteger(L, 1);
+        lua_Integer count = luaL_checkinteger(L, 2);
+        size_t index;
+        // Reading nothing succeeds wherever it starts
+        if (count == 0) {
+            lua_newtable(L);
+            return 1;
+        }
+        if (!scan_range(image, table, addr, count, index)) {
+            lua_pushnil(L);
+            return 1;
+        }
+        // Counts fit an int once the range is mapped, which lua_rawseti takes on 5.1
+        lua_createtable(L, static_cast<int>(count), 0);
+        for (int i = 0; i < count; i++) {
+            T value = values[index + static_cast<size_t>(i)];
+            if constexpr (sizeof(T) == 1) {
+                lua_pushboolean(L, value);
+            } else {
+                lua_pushinteger(L, value);
+            }
+            lua_rawseti(L, -2, i + 1);
+        }
+        return 1;
+    }
+
+    // Writes a 1-based array to consecutive addresses; false if the range is not mapped
+    template <typename T>
+    int write_range(lua_State* L, const ProcessImage* image, ProcessImage::Table table, std::vector<T>& values) {
+        lua_Integer addr = luaL_checkinteger(L, 1);
+        luaL_checktype(L, 2, LUA_TTABLE);
+        auto count = static_cast<lua_Integer>(lua_rawlen(L, 2));
+        size_t index;
+        // An empty array writes nothing and succeeds, like a zero-length read
+        if (count == 0) {
+            lua_pushboolean(L, true);
+            return 1;
+        }
+        if (!scan_range(image, table, addr, count, index)) {
+            lua_pushboolean(L, false);
+            return 1;
+        }
+        for (int i = 0; i < count; i++) {
+            lua_rawgeti(L, 2, i + 1);
+            T& value = values[index + static_cast<size_t>(i)];
+            if constexpr (sizeof(T) == 1) {
+                value = lua_toboolean(L, -1) ? 1 : 0;
+            } else {
+                value = static_cast<T>(lua_tointeger(L, -1));
+            }
+            lua_pop(L, 1);
+        }
+        lua_pushboolean(L, true);
+        return 1;
+    }
+
+    // Copies a table over one of the same size without reallocating it
+    template <typename T>
+    void copy_in_place(const std::vector<T>& from, std::vector<T>& to) {
+        std::copy(from.begin(), from.end(), to.begin());
+    }
+
+#ifdef SIMPLEPLC_HAVE_LUAJIT
+    // Scan image index of every Modbus address of a table, -1 where no block is configured
+    std::vector<int32_t> address_map(const ProcessImage& image, ProcessImage::Table table) {
+        std::vector<int32_t> map(SegmentMap::ADDRESS_SPACE, -1);
+        for (const auto& segment : image.layout(table).segments()) {
+            for (int addr = segment.start; addr < segment.start + segment.count; addr++) {
+                int index;
+                if (image.translate(table, addr, 1, index)) {
+                    map[static_cast<size_t>(addr)] = index;
+                }
+            }
+        }
+        return map;
+    }
+
+    // Replaces the image proxies with FFI structs over the scan image. Their metamethods are
+    // Lua functions, so the JIT compiles image.hr[5] = 42 into a map lookup and a store.
+    // Arguments: the image table, the address space size, then a data and an address map
+    // pointer for coils, discrete inputs, holding registers and input registers.
+    const char* const FFI_IMAGE = R"lua(
+local ffi = require("ffi")
+local image, space, coils, coil_map, di, di_map, hr, hr_map, ir, ir_map = ...
+
+ffi.cdef[[
+typedef struct { uint8_t* data; const int32_t* map; } simpleplc_bits;
+typedef struct { uint16_t* data; const int32_t* map; } simpleplc_registers;
+]]
+
+local function slot(t, address)
+    if type(address) ~= "number" then
+        error("bad address (number expected, got " .. type(address) .. ")", 3)
+    end
+    if address < 0 or address >= space then
+        return -1
+    end
+    return t.map[address]
+end
+
+local function unmapped(address)
+    error("address " .. address .. " is not mapped", 3)
+end
+
+local bits = ffi.metatype("simpleplc_bits", {
+    __index = function(t, address)
+        local i = slot(t, address)
+        if i < 0 then
+            return nil
+        end
+        return t.data[i] ~= 0
+    end,
+    __newindex = function(t, address, value)
+        local i = slot(t, address)
+        if i < 0 then
+            unmapped(address)
+        end
+        t.data[i] = value and 1 or 0
+    end,
+})
+
+local registers = ffi.metatype("simpleplc_registers", {
+    __index = function(t, address)
+        local i = slot(t, address)
+        if i < 0 then
+            return nil
+        end
+        return t.data[i]
+    end,
+    __newindex = function(t, address, value)
+        local i = slot(t, address)
+        if i < 0 then
+            unmapped(address)
+        end
+        -- Same rule as the C proxies: a whole number that fits 16 bits, signed or unsigned
+        if type(value) ~= "number" or value ~= math.floor(value) or value < -32768 or value > 65535 then
+            error("bad value for address " .. address .. " (integer from -32768 to 65535 expected)", 2)
+        end
+        t.data[i] = value < 0 and value + 65536 or value
+    end,
+})
+
+image.coil = bits(ffi.cast("uint8_t*", coils), ffi.cast("const int32_t*", coil_map))
+image.di = bits(ffi.cast("uint8_t*", di), ffi.cast("const int32_t*", di_map))
+image.hr = registers(ffi.cast("uint16_t*", hr), ffi.cast("const int32_t*", hr_map))
+image.ir = registers(ffi.cast("uint16_t*", ir), ffi.cast("const int32_t*", ir_map))
+)lua";
+#endif
+
+    // Scan images hold one byte per bit whatever the process image's bit layout
+    ProcessImage::Tables scan_tables(const ProcessImage& image) {
+        using Table = ProcessImage::Table;
+        ProcessImage::Tables tables;
+        tables.coils.resize(static_cast<size_t>(image.size(Table::Coils)));
+        tables.discrete_inputs.resize(static_cast<size_t>(image.size(Table::DiscreteInputs)));
+        tables.holding_registers.resize(static_cast<size_t>(image.size(Table::HoldingRegisters)));
+        tables.input_registers.resize(static_cast<size_t>(image.size(Table::InputRegisters)));
+        return tables;
+    }
+
+    // Copies a range of entries from the process image into a scan image
+    void copy_range(const ProcessImage::Tables& from, ProcessImage::Table table, int index, int count,
+                    ProcessImage::Tables& to) {
+        if (count <= 0) {
+            return;
+        }
+        if (table == ProcessImage::Table::Coils || table == ProcessImage::Table::DiscreteInputs) {
+            from.copy_bits(table, index, count, to.bits(table) + index);
+        } else {
+            std::copy_n(from.registers(table) + index, count, to.registers(table) + index);
+        }
+    }
+
+    // Copies the blocks of a table published after since
+    void copy_changes(const ProcessImage& image, ProcessImage::Table table, uint64_t since,
+                      const ProcessImage::Tables& from, ProcessImage::Tables& to) {
+        image.for_each_change(table, since, [&](int index, int count) {
+            copy_range(from, table, index, count, to);
+        });
+    }
+
+    // Hands every run of entries that differ between before and after to write(index, count, values)
+    template <typename T, typename Write>
+    void commit_changes(const std::vector<T>& before, const std::vector<T>& after, Write write) {
+        const auto* before_bytes = reinterpret_cast<const uint8_t*>(before.data());
+        const auto* after_bytes = reinterpret_cast<const uint8_t*>(after.data());
+        size_t i = 0;
+        while (i < after.size()) {
+            // Unchanged stretches are skipped a vector at a time
+            i += bit_kernels::first_difference(before_bytes + i * sizeof(T), after_bytes + i * sizeof(T),
+                                               (after.size() - i) * sizeof(T)) / sizeof(T);
+            if (i >= after.size()) {
+                break;
+            }
+            size_t end = i + 1;
+            while (end < after.size() && before[end] != after[end]) {
+                end++;
+            }
+            write(static_cast<int>(i), static_cast<int>(end - i), after.data() + i);
+            i = end;
+        }
+    }
+}
 
 // This function is not currently used - commenting out to avoid warnings
 /*
@@ -29,16 +277,13 @@ static uint64_t now_ms() {
 }
 */
 
-void PlcLogic::start(modbus_mapping_t* mapping) {
-    if (!mapping) {
-        throw std::runtime_error("Invalid Modbus mapping");
+void PlcLogic::start(ProcessImage* image) {
+    using Table = ProcessImage::Table;
+    if (!image) {
+        throw std::runtime_error("Invalid process image");
     }
     
-    if (!mapping->tab_input_bits) {
-        throw std::runtime_error("Input bits array is null");
-    }
-    
-    if (mapping->nb_input_bits <= 0) {
+    if (image->size(Table::DiscreteInputs) <= 0) {
         throw std::runtime_error("No input bits allocated");
     }
     
@@ -46,97 +291,146 @@ void PlcLogic::start(modbus_mapping_t* mapping) {
         throw std::runtime_error("PLC logic already running");
     }
     
-    mb_mapping = mapping;
+    process_image = image;
     
-    std::cout << "[PLC-DEBUG] Modbus mapping sizes:" << std::endl
-              << "  Coils (bits): " << mb_mapping->nb_bits << std::endl
-              << "  Input bits: " << mb_mapping->nb_input_bits << std::endl
-              << "  Registers: " << mb_mapping->nb_registers << std::endl
-              << "  Input registers: " << mb_mapping->nb_input_registers << std::endl;
+    std::cout << "[PLC-DEBUG] Process image sizes:" << std::endl
+              << "  Coils (bits): " << process_image->size(Table::Coils) << std::endl
+              << "  Input bits: " << process_image->size(Table::DiscreteInputs) << std::endl
+              << "  Registers: " << process_image->size(Table::HoldingRegisters) << std::endl
+              << "  Input registers: " << process_image->size(Table::InputRegisters) << std::endl;
     
-    lua_state = luaL_newstate();
-    luaL_openlibs(lua_state);
-    setupLuaBindings(lua_state);
+    // Without [Task:<name>] sections, run_script's cycle() is the only task
+    std::vector<TaskConfig> configs = DeviceConfig::getTasks();
+    if (configs.empty()) {
+        TaskConfig main_task;
+        main_task.name = "main";
+        main_task.period_ms = DeviceConfig::getDeviceInfo().scan_period_ms;
+        configs.push_back(main_task);
+    }
+    
+#ifdef SIMPLEPLC_HAVE_LUAJIT
+    address_maps = {address_map(*image, Table::Coils), address_map(*image, Table::DiscreteInputs),
+                    address_map(*image, Table::HoldingRegisters), address_map(*image, Table::InputRegisters)};
+#endif
+    
+    for (const auto& config : configs) {
+        auto task = std::make_unique<Task>();
+        task->config = config;
+        task->script = config.script.empty() ? DeviceConfig::getDeviceInfo().run_script : config.script;
+        // Sized before the Lua state exists and never reallocated: the FFI image proxies point into it
+        task->scan_image = scan_tables(*image);
+        task->scan_inputs = task->scan_image;
+        task->lua_state = newLuaState(*task);
+        tasks.push_back(std::move(task));
+    }
     
     running = true;
     
     try {
-        thread = std::thread(loop);
-    } catch (const std::exception& e) {
-        running = false;
-        mb_mapping = nullptr;
-        if (lua_state) {
-            lua_close(lua_state);
-            lua_state = nullptr;
+        for (size_t i = 0; i < tasks.size(); i++) {
+            // Only the first task watches the keyboard for script reloads
+            tasks[i]->thread = std::thread(loop, std::ref(*tasks[i]), i == 0);
         }
+    } catch (const std::exception& e) {
+        stop();
+        process_image = nullptr;
         throw;
     }
 }
 
 void PlcLogic::stop() {
     running = false;
-    if (thread.joinable())
-        thread.join();
+    for (auto& task : tasks) {
+        if (task->thread.joinable())
+            task->thread.join();
+    }
     
-    if (lua_state) {
-        lua_close(lua_state);
-        lua_state = nullptr;
+    for (auto& task : tasks) {
+        if (task->lua_state) {
+            lua_close(task->lua_state);
+            task->lua_state = nullptr;
+        }
     }
+    tasks.clear();
     
     platform::disableRawMode();
 }
 
 void PlcLogic::loadScript(const std::string& scriptPath) {
-    std::cout << "[PLC] Loading Lua script from: " << scriptPath << std::endl;
-    std::unique_lock<std::timed_mutex> lock(mb_mutex, std::defer_lock);
+    // A [Task:name] section with its own script owns that task's Lua state
+    for (auto& task : tasks) {
+        if (!task->config.script.empty()) {
+            continue;
+        }
+        loadScript(*task, scriptPath);
+    }
+}
+
+void PlcLogic::loadScript(Task& task, const std::string& scriptPath) {
+    std::cout << "[PLC] Loading Lua script from: " << scriptPath << " (task " << task.config.name << ")" << std::endl;
+    std::unique_lock<std::timed_mutex> lock(task.script_mutex, std::defer_lock);
     if (!lock.try_lock_for(std::chrono::milliseconds(1000))) {
         throw std::runtime_error("Failed to acquire mutex when loading script");
     }
     
-    if (luaL_dofile(lua_state, scriptPath.c_str()) != 0) {
-        std::string error = lua_tostring(lua_state, -1);
-        lua_pop(lua_state, 1);
+    // Top-level script code runs against the scan image like a cycle
+    beginScan(task);
+    int result = luaL_dofile(task.lua_state, scriptPath.c_str());
+    commitScan(task);
+    if (result != 0) {
+        std::string error = lua_tostring(task.lua_state, -1);
+        lua_pop(task.lua_state, 1);
         std::cerr << "[PLC] Failed to load Lua script: " << error << std::endl;
         throw std::runtime_error("Failed to load Lua script: " + error);
     }
     std::cout << "[PLC] Lua script loaded successfully" << std::endl;
 }
 
-void PlcLogic::reloadScript(const std::string& scriptPath) {
-    std::cout << "\n[PLC] Reloading script: " << scriptPath << std::endl;
-    std::unique_lock<std::timed_mutex> lock(mb_mutex, std::defer_lock);
+void PlcLogic::reloadScript(Task& task) {
+    std::cout << "\n[PLC] Reloading script: " << task.script << " (task " << task.config.name << ")" << std::endl;
+    std::unique_lock<std::timed_mutex> lock(task.script_mutex, std::defer_lock);
     if (!lock.try_lock_for(std::chrono::milliseconds(1000))) {
         std::cerr << "[PLC] Failed to acquire mutex for script reload" << std::endl;
         return;
     }
 
-    if (lua_state) {
-        lua_close(lua_state);
+    if (task.lua_state) {
+        lua_close(task.lua_state);
     }
     
-    lua_state = luaL_newstate();
-    luaL_openlibs(lua_state);
-    setupLuaBindings(lua_state);
+    task.lua_state = newLuaState(task);
     
-    if (luaL_dofile(lua_state, scriptPath.c_str()) != 0) {
-        std::string error = lua_tostring(lua_state, -1);
-        lua_pop(lua_state, 1);
+    beginScan(task);
+    int result = luaL_dofile(task.lua_state, task.script.c_str());
+    commitScan(task);
+    if (result != 0) {
+        std::string error = lua_tostring(task.lua_state, -1);
+        lua_pop(task.lua_state, 1);
         std::cerr << "[PLC] Failed to reload Lua script: " << error << std::endl;
     } else {
         std::cout << "[PLC] Script reloaded successfully" << std::endl;
     }
 }
 
+std::string PlcLogic::getStatistics() {
+    std::string report;
+    for (const auto& task : tasks) {
+        report += task->statistics.report(task->config.name,
+                                          static_cast<uint64_t>(task->config.period_ms) * 1000000ULL);
+    }
+    return report;
+}
+
+PlcLogic::Task& PlcLogic::taskOf(lua_State* L) {
+    return *static_cast<Task*>(lua_touserdata(L, lua_upvalueindex(1)));
+}
+
 int PlcLogic::lua_readCoil(lua_State* L) {
+    Task& task = taskOf(L);
     lua_Integer addr_val = luaL_checkinteger(L, 1);
-    int addr = static_cast<int>(addr_val);
-    std::unique_lock<std::timed_mutex> lock(mb_mutex, std::defer_lock);
-    if (!lock.try_lock_for(std::chrono::milliseconds(1000))) {
-        lua_pushnil(L);
-        return 1;
-    }
-    if (addr >= 0 && addr < mb_mapping->nb_bits) {
-        lua_pushboolean(L, mb_mapping->tab_bits[addr]);
+    size_t index;
+    if (scan_index(process_image, ProcessImage::Table::Coils, addr_val, index)) {
+        lua_pushboolean(L, task.scan_image.coils[index]);
     } else {
         lua_pushnil(L);
     }
@@ -144,16 +438,12 @@ int PlcLogic::lua_readCoil(lua_State* L) {
 }
 
 int PlcLogic::lua_writeCoil(lua_State* L) {
+    Task& task = taskOf(L);
     lua_Integer addr_val = luaL_checkinteger(L, 1);
-    int addr = static_cast<int>(addr_val);
     bool value = lua_toboolean(L, 2);
-    std::unique_lock<std::timed_mutex> lock(mb_mutex, std::defer_lock);
-    if (!lock.try_lock_for(std::chrono::milliseconds(1000))) {
-        lua_pushboolean(L, false);
-        return 1;
-    }
-    if (addr >= 0 && addr < mb_mapping->nb_bits) {
-        mb_mapping->tab_bits[addr] = value;
+    size_t index;
+    if (scan_index(process_image, ProcessImage::Table::Coils, addr_val, index)) {
+        task.scan_image.coils[index] = value ? 1 : 0;
         lua_pushboolean(L, true);
     } else {
         lua_pushboolean(L, false);
@@ -162,15 +452,11 @@ int PlcLogic::lua_writeCoil(lua_State* L) {
 }
 
 int PlcLogic::lua_readDiscreteInput(lua_State* L) {
+    Task& task = taskOf(L);
     lua_Integer addr_val = luaL_checkinteger(L, 1);
-    int addr = static_cast<int>(addr_val);
-    std::unique_lock<std::timed_mutex> lock(mb_mutex, std::defer_lock);
-    if (!lock.try_lock_for(std::chrono::milliseconds(1000))) {
-        lua_pushnil(L);
-        return 1;
-    }
-    if (addr >= 0 && addr < mb_mapping->nb_input_bits) {
-        lua_pushboolean(L, mb_mapping->tab_input_bits[addr]);
+    size_t index;
+    if (scan_index(process_image, ProcessImage::Table::DiscreteInputs, addr_val, index)) {
+        lua_pushboolean(L, task.scan_image.discrete_inputs[index]);
     } else {
         lua_pushnil(L);
     }
@@ -178,15 +464,11 @@ int PlcLogic::lua_readDiscreteInput(lua_State* L) {
 }
 
 int PlcLogic::lua_readHoldingRegister(lua_State* L) {
+    Task& task = taskOf(L);
     lua_Integer addr_val = luaL_checkinteger(L, 1);
-    int addr = static_cast<int>(addr_val);
-    std::unique_lock<std::timed_mutex> lock(mb_mutex, std::defer_lock);
-    if (!lock.try_lock_for(std::chrono::milliseconds(1000))) {
-        lua_pushnil(L);
-        return 1;
-    }
-    if (addr >= 0 && addr < mb_mapping->nb_registers) {
-        lua_pushinteger(L, mb_mapping->tab_registers[addr]);
+    size_t index;
+    if (scan_index(process_image, ProcessImage::Table::HoldingRegisters, addr_val, index)) {
+        lua_pushinteger(L, task.scan_image.holding_registers[index]);
     } else {
         lua_pushnil(L);
     }
@@ -194,17 +476,13 @@ int PlcLogic::lua_readHoldingRegister(lua_State* L) {
 }
 
 int PlcLogic::lua_writeHoldingRegister(lua_State* L) {
+    Task& task = taskOf(L);
     lua_Integer addr_val = luaL_checkinteger(L, 1);
-    int addr = static_cast<int>(addr_val);
     lua_Integer value_val = luaL_checkinteger(L, 2);
     int value = static_cast<int>(value_val);
-    std::unique_lock<std::timed_mutex> lock(mb_mutex, std::defer_lock);
-    if (!lock.try_lock_for(std::chrono::milliseconds(1000))) {
-        lua_pushboolean(L, false);
-        return 1;
-    }
-    if (addr >= 0 && addr < mb_mapping->nb_registers) {
-        mb_mapping->tab_registers[addr] = static_cast<uint16_t>(value);
+    size_t index;
+    if (scan_index(process_image, ProcessImage::Table::HoldingRegisters, addr_val, index)) {
+        task.scan_image.holding_registers[index] = static_cast<uint16_t>(value);
         lua_pushboolean(L, true);
     } else {
         lua_pushboolean(L, false);
@@ -241,15 +519,11 @@ int PlcLogic::lua_print(lua_State* L) {
 }
 
 int PlcLogic::lua_readInputRegister(lua_State* L) {
+    Task& task = taskOf(L);
     lua_Integer addr_val = luaL_checkinteger(L, 1);
-    int addr = static_cast<int>(addr_val);
-    std::unique_lock<std::timed_mutex> lock(mb_mutex, std::defer_lock);
-    if (!lock.try_lock_for(std::chrono::milliseconds(1000))) {
-        lua_pushnil(L);
-        return 1;
-    }
-    if (addr >= 0 && addr < mb_mapping->nb_input_registers) {
-        lua_pushinteger(L, mb_mapping->tab_input_registers[addr]);
+    size_t index;
+    if (scan_index(process_image, ProcessImage::Table::InputRegisters, addr_val, index)) {
+        lua_pushinteger(L, task.scan_image.input_registers[index]);
     } else {
         lua_pushnil(L);
     }
@@ -257,17 +531,13 @@ int PlcLogic::lua_readInputRegister(lua_State* L) {
 }
 
 int PlcLogic::lua_writeInputRegister(lua_State* L) {
+    Task& task = taskOf(L);
     lua_Integer addr_val = luaL_checkinteger(L, 1);
-    int addr = static_cast<int>(addr_val);
     lua_Integer value_val = luaL_checkinteger(L, 2);
     int value = static_cast<int>(value_val);
-    std::unique_lock<std::timed_mutex> lock(mb_mutex, std::defer_lock);
-    if (!lock.try_lock_for(std::chrono::milliseconds(1000))) {
-        lua_pushboolean(L, false);
-        return 1;
-    }
-    if (addr >= 0 && addr < mb_mapping->nb_input_registers) {
-        mb_mapping->tab_input_registers[addr] = static_cast<uint16_t>(value);
+    size_t index;
+    if (scan_index(process_image, ProcessImage::Table::InputRegisters, addr_val, index)) {
+        task.scan_image.input_registers[index] = static_cast<uint16_t>(value);
         lua_pushboolean(L, true);
     } else {
         lua_pushboolean(L, false);
@@ -276,16 +546,12 @@ int PlcLogic::lua_writeInputRegister(lua_State* L) {
 }
 
 int PlcLogic::lua_writeDiscreteInput(lua_State* L) {
+    Task& task = taskOf(L);
     lua_Integer addr_val = luaL_checkinteger(L, 1);
-    int addr = static_cast<int>(addr_val);
     bool value = lua_toboolean(L, 2);
-    std::unique_lock<std::timed_mutex> lock(mb_mutex, std::defer_lock);
-    if (!lock.try_lock_for(std::chrono::milliseconds(1000))) {
-        lua_pushboolean(L, false);
-        return 1;
-    }
-    if (addr >= 0 && addr < mb_mapping->nb_input_bits) {
-        mb_mapping->tab_input_bits[addr] = value;
+    size_t index;
+    if (scan_index(process_image, ProcessImage::Table::DiscreteInputs, addr_val, index)) {
+        task.scan_image.discrete_inputs[index] = value ? 1 : 0;
         lua_pushboolean(L, true);
     } else {
         lua_pushboolean(L, false);
@@ -293,110 +559,348 @@ int PlcLogic::lua_writeDiscreteInput(lua_State* L) {
     return 1;
 }
 
-void PlcLogic::setupLuaBindings(lua_State* L) {
-    lua_pushcfunction(L, lua_print);
-    lua_setglobal(L, "print");
-    
-    lua_newtable(L);
-    
-    lua_pushcfunction(L, lua_readCoil);
-    lua_setfield(L, -2, "readCoil");
-    
-    lua_pushcfunction(L, lua_writeCoil);
-    lua_setfield(L, -2, "writeCoil");
-    
-    lua_pushcfunction(L, lua_readDiscreteInput);
-    lua_setfield(L, -2, "readDiscreteInput");
-    
-    lua_pushcfunction(L, lua_writeDiscreteInput);
-    lua_setfield(L, -2, "writeDiscreteInput");
+void PlcLogic::beginScan(Task& task) {
+    using Table = ProcessImage::Table;
+    // Taken first: anything published during the copy is copied again next scan
+    uint64_t generation = process_image->generation();
+    process_image->read([&task](const ProcessImage::Tables& tables) {
+        for (Table table : {Table::Coils, Table::DiscreteInputs, Table::HoldingRegisters, Table::InputRegisters}) {
+            if (task.scan_synced) {
+                copy_changes(*process_image, table, task.scan_generation, tables, task.scan_inputs);
+            } else {
+                copy_range(tables, table, 0, process_image->size(table), task.scan_inputs);
+            }
+        }
+    });
+    task.scan_generation = generation;
+    task.scan_synced = true;
+    copy_in_place(task.scan_inputs.coils, task.scan_image.coils);
+    copy_in_place(task.scan_inputs.discrete_inputs, task.scan_image.discrete_inputs);
+    copy_in_place(task.scan_inputs.holding_registers, task.scan_image.holding_registers);
+    copy_in_place(task.scan_inputs.input_registers, task.scan_image.input_registers);
+}
 
-    lua_pushcfunction(L, lua_readHoldingRegister);
-    lua_setfield(L, -2, "readHoldingRegister");
+void PlcLogic::commitScan(Task& task) {
+    using Table = ProcessImage::Table;
+    if (task.scan_image.coils == task.scan_inputs.coils &&
+        task.scan_image.discrete_inputs == task.scan_inputs.discrete_inputs &&
+        task.scan_image.holding_registers == task.scan_inputs.holding_registers &&
+        task.scan_image.input_registers == task.scan_inputs.input_registers) {
+        return;
+    }
     
-    lua_pushcfunction(L, lua_writeHoldingRegister);
-    lua_setfield(L, -2, "writeHoldingRegister");
+    // Only entries the scan changed are written, so concurrent changes to the rest survive
+    ProcessImage::Transaction transaction(*process_image);
+    commit_changes(task.scan_inputs.coils, task.scan_image.coils, [&](int index, int count, const uint8_t* values) {
+        transaction.write_bits(Table::Coils, index, count, values);
+    });
+    commit_changes(task.scan_inputs.discrete_inputs, task.scan_image.discrete_inputs, [&](int index, int count, const uint8_t* values) {
+        transaction.write_bits(Table::DiscreteInputs, index, count, values);
+    });
+    commit_changes(task.scan_inputs.holding_registers, task.scan_image.holding_registers, [&](int index, int count, const uint16_t* values) {
+        std::copy_n(values, count, transaction.modify_registers(Table::HoldingRegisters, index, count));
+    });
+    commit_changes(task.scan_inputs.input_registers, task.scan_image.input_registers, [&](int index, int count, const uint16_t* values) {
+        std::copy_n(values, count, transaction.modify_registers(Table::InputRegisters, index, count));
+    });
+}
+
+int PlcLogic::lua_readCoils(lua_State* L) {
+    return read_range(L, process_image, ProcessImage::Table::Coils, taskOf(L).scan_image.coils);
+}
+
+int PlcLogic::lua_writeCoils(lua_State* L) {
+    return write_range(L, process_image, ProcessImage::Table::Coils, taskOf(L).scan_image.coils);
+}
+
+int PlcLogic::lua_readDiscreteInputs(lua_State* L) {
+    return read_range(L, process_image, ProcessImage::Table::DiscreteInputs, taskOf(L).scan_image.discrete_inputs);
+}
+
+int PlcLogic::lua_writeDiscreteInputs(lua_State* L) {
+    return write_range(L, process_image, ProcessImage::Table::DiscreteInputs, taskOf(L).scan_image.discrete_inputs);
+}
+
+int PlcLogic::lua_readHoldingRegisters(lua_State* L) {
+    return read_range(L, process_image, ProcessImage::Table::HoldingRegisters, taskOf(L).scan_image.holding_registers);
+}
+
+int PlcLogic::lua_writeHoldingRegisters(lua_State* L) {
+    return write_range(L, process_image, ProcessImage::Table::HoldingRegisters, taskOf(L).scan_image.holding_registers);
+}
+
+int PlcLogic::lua_readInputRegisters(lua_State* L) {
+    return read_range(L, process_image, ProcessImage::Table::InputRegisters, taskOf(L).scan_image.input_registers);
+}
+
+int PlcLogic::lua_writeInputRegisters(lua_State* L) {
+    return write_range(L, process_image, ProcessImage::Table::InputRegisters, taskOf(L).scan_image.input_registers);
+}
+
+int PlcLogic::lua_imageIndex(lua_State* L) {
+    using Table = ProcessImage::Table;
+    // The metatable is protected, so argument 1 is always one of the proxies
+    const auto* proxy = static_cast<const ImageProxy*>(lua_touserdata(L, 1));
+    lua_Integer addr_val = luaL_checkinteger(L, 2);
+    size_t index;
+    if (!scan_index(process_image, proxy->table, addr_val, index)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    const ProcessImage::Tables& image = proxy->task->scan_image;
+    switch (proxy->table) {
+        case Table::Coils:            lua_pushboolean(L, image.coils[index]); break;
+        case Table::DiscreteInputs:   lua_pushboolean(L, image.discrete_inputs[index]); break;
+        case Table::HoldingRegisters: lua_pushinteger(L, image.holding_registers[index]); break;
+        case Table::InputRegisters:   lua_pushinteger(L, image.input_registers[index]); break;
+    }
+    return 1;
+}
+
+int PlcLogic::lua_imageNewIndex(lua_State* L) {
+    using Table = ProcessImage::Table;
+    const auto* proxy = static_cast<const ImageProxy*>(lua_touserdata(L, 1));
+    lua_Integer addr_val = luaL_checkinteger(L, 2);
+    size_t index;
+    // An assignment has no result to report failure with, so unmapped addresses raise an error
+    if (!scan_index(process_image, proxy->table, addr_val, index)) {
+        return luaL_error(L, "address %d is not mapped", static_cast<int>(addr_val));
+    }
+    ProcessImage::Tables& image = proxy->task->scan_image;
+    switch (proxy->table) {
+        case Table::Coils:
+            image.coils[index] = lua_toboolean(L, 3) ? 1 : 0;
+            break;
+        case Table::DiscreteInputs:
+            image.discrete_inputs[index] = lua_toboolean(L, 3) ? 1 : 0;
+            break;
+        case Table::HoldingRegisters:
+        case Table::InputRegisters: {
+            uint16_t value;
+            if (!register_value(L, 3, value)) {
+                return luaL_error(L, "bad value for address %d (integer from -32768 to 65535 expected)",
+                                  static_cast<int>(addr_val));
+            }
+            auto& registers = proxy->table == Table::HoldingRegisters ? image.holding_registers : image.input_registers;
+            registers[index] = value;
+            break;
+        }
+    }
+    return 0;
+}
+
+int PlcLogic::lua_pushFifo(lua_State* L) {
+    lua_Integer addr_val = luaL_checkinteger(L, 1);
+    lua_Integer value_val = luaL_checkinteger(L, 2);
+    // Samples bypass the scan image so clients see every one, not just the last of the scan
+    FifoQueue* fifo = addr_val >= 0 && addr_val < SegmentMap::ADDRESS_SPACE
+        ? process_image->fifo(static_cast<int>(addr_val)) : nullptr;
+    lua_pushboolean(L, fifo && fifo->push(static_cast<uint16_t>(value_val)));
+    return 1;
+}
+
+lua_State* PlcLogic::newLuaState(Task& task) {
+    lua_State* L = luaL_newstate();
+    luaL_openlibs(L);
     
-    lua_pushcfunction(L, lua_readInputRegister);
-    lua_setfield(L, -2, "readInputRegister");
+    lua_pushcfunction(L, lua_print);
+    lua_setglobal(L, "print");
     
-    lua_pushcfunction(L, lua_writeInputRegister);
-    lua_setfield(L, -2, "writeInputRegister");
+    // Every binding carries its task as an upvalue, so tasks never share a scan image
+    auto bind = [&](const char* name, lua_CFunction function) {
+        lua_pushlightuserdata(L, &task);
+        lua_pushcclosure(L, function, 1);
+        lua_setfield(L, -2, name);
+    };
     
-
+    lua_newtable(L);
+    bind("readCoil", lua_readCoil);
+    bind("writeCoil", lua_writeCoil);
+    bind("readDiscreteInput", lua_readDiscreteInput);
+    bind("writeDiscreteInput", lua_writeDiscreteInput);
+    bind("readHoldingRegister", lua_readHoldingRegister);
+    bind("writeHoldingRegister", lua_writeHoldingRegister);
+    bind("readInputRegister", lua_readInputRegister);
+    bind("writeInputRegister", lua_writeInputRegister);
+    bind("pushFifo", lua_pushFifo);
     
+    // Range variants move a whole block per call: readX(start, count) returns a 1-based array,
+    // writeX(start, values) writes one
+    bind("readCoils", lua_readCoils);
+    bind("writeCoils", lua_writeCoils);
+    bind("readDiscreteInputs", lua_readDiscreteInputs);
+    bind("writeDiscreteInputs", lua_writeDiscreteInputs);
+    bind("readHoldingRegisters", lua_readHoldingRegisters);
+    bind("writeHoldingRegisters", lua_writeHoldingRegisters);
+    bind("readInputRegisters", lua_readInputRegisters);
+    bind("writeInputRegisters", lua_writeInputRegisters);
     lua_setglobal(L, "modbus");
+    
+    // image.hr[5] = 42 and image.coil[3] index the scan image directly, without a function lookup
+    lua_newtable(L);
+    lua_newtable(L);
+    lua_pushcfunction(L, lua_imageIndex);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, lua_imageNewIndex);
+    lua_setfield(L, -2, "__newindex");
+    lua_pushliteral(L, "image");
+    lua_setfield(L, -2, "__metatable");
+    auto proxy = [&](const char* name, ProcessImage::Table table) {
+        new (lua_newuserdata(L, sizeof(ImageProxy))) ImageProxy{&task, table};
+        lua_pushvalue(L, -2);
+        lua_setmetatable(L, -2);
+        lua_setfield(L, -3, name);
+    };
+    proxy("coil", ProcessImage::Table::Coils);
+    proxy("di", ProcessImage::Table::DiscreteInputs);
+    proxy("hr", ProcessImage::Table::HoldingRegisters);
+    proxy("ir", ProcessImage::Table::InputRegisters);
+    lua_pop(L, 1);
+    lua_setglobal(L, "image");
+#ifdef SIMPLEPLC_HAVE_LUAJIT
+    bindImageFfi(task, L);
+#endif
+    return L;
+}
+
+#ifdef SIMPLEPLC_HAVE_LUAJIT
+void PlcLogic::bindImageFfi(Task& task, lua_State* L) {
+    using Table = ProcessImage::Table;
+    if (luaL_loadstring(L, FFI_IMAGE) != 0) {
+        std::cerr << "[PLC] Failed to compile the FFI image binding: " << lua_tostring(L, -1) << std::endl;
+        lua_pop(L, 1);
+        return;
+    }
+    lua_getglobal(L, "image");
+    lua_pushinteger(L, SegmentMap::ADDRESS_SPACE);
+    lua_pushlightuserdata(L, task.scan_image.coils.data());
+    lua_pushlightuserdata(L, address_maps[static_cast<size_t>(Table::Coils)].data());
+    lua_pushlightuserdata(L, task.scan_image.discrete_inputs.data());
+    lua_pushlightuserdata(L, address_maps[static_cast<size_t>(Table::DiscreteInputs)].data());
+    lua_pushlightuserdata(L, task.scan_image.holding_registers.data());
+    lua_pushlightuserdata(L, address_maps[static_cast<size_t>(Table::HoldingRegisters)].data());
+    lua_pushlightuserdata(L, task.scan_image.input_registers.data());
+    lua_pushlightuserdata(L, address_maps[static_cast<size_t>(Table::InputRegisters)].data());
+    // On failure image.* keeps the C proxies, which behave the same
+    if (lua_pcall(L, 10, 0, 0) != 0) {
+        std::cerr << "[PLC] FFI image binding failed, using the C proxies: " << lua_tostring(L, -1) << std::endl;
+        lua_pop(L, 1);
+    }
 }
+#endif
 
-void PlcLogic::loop() {
-    std::cout << "[PLC] Logic thread starting... " << std::endl;
-    std::cout << "[PLC] Press SPACE to reload the script" << std::endl;
+void PlcLogic::loop(Task& task, bool console) {
+    const TaskConfig& config = task.config;
+    std::cout << "[PLC] Task " << config.name << " starting: " << task.script << ", " << config.entry
+              << "() every " << config.period_ms << " ms" << std::endl;
     
-    platform::enableRawMode();
-    constexpr std::chrono::milliseconds SCAN_INTERVAL(1000);
-    int cycle_count = 0;
+    if (config.cpu >= 0 && !platform::pin_current_thread(config.cpu)) {
+        std::cerr << "[PLC] Could not pin task " << config.name << " to CPU " << config.cpu << std::endl;
+    }
+    if (config.priority > 0 && !platform::set_realtime_priority(config.priority)) {
+        std::cerr << "[PLC] Could not give task " << config.name << " real-time priority " << config.priority
+                  << ", running with normal scheduling" << std::endl;
+    }
     
-    // Get script path from config
-    std::string scriptPath = DeviceConfig::getDeviceInfo().run_script;
-    std::cout << "[PLC] Using script: " << scriptPath << std::endl;
+    if (console) {
+        std::cout << "[PLC] Press SPACE to reload the scripts" << std::endl;
+        platform::enableRawMode();
+    }
+    int cycle_count = 0;
     
     // Load the script initially
     try {
-        loadScript(scriptPath);
+        loadScript(task, task.script);
     } catch (const std::exception& e) {
         std::cerr << "[PLC] Failed to load initial script: " << e.what() << std::endl;
     }
 
+    // Scans start on a fixed grid of absolute deadlines, so execution time does not stretch the period
+    const uint64_t scan_period_ns = static_cast<uint64_t>(config.period_ms) * 1000000ULL;
+    uint64_t deadline = platform::monotonic_ns();
+
     while (running) {
+        uint64_t started = platform::monotonic_ns();
+        
         // Check for space key press
-        if (platform::kbhit()) {
+        if (console && platform::kbhit()) {
             int key_pressed = platform::getch();
             if (key_pressed == ' ') {
-                reloadScript(scriptPath);
+                for (auto& other : tasks) {
+                    reloadScript(*other);
+                }
             }
         }
 
-        lua_State* current_state = nullptr;
-        
-        // cycle function mutex locked
+        // The whole scan runs under the task's script mutex against its private scan image
+        bool scanned = false;
         {
-            std::unique_lock<std::timed_mutex> lock(mb_mutex, std::defer_lock);
+            std::unique_lock<std::timed_mutex> lock(task.script_mutex, std::defer_lock);
             if (!lock.try_lock_for(std::chrono::milliseconds(1000))) {
-                std::cerr << "[PLC] Failed to acquire mutex in cycle " << cycle_count << std::endl;
-                std::this_thread::sleep_for(SCAN_INTERVAL);
-                continue;
-            }
-            
-            current_state = lua_state;
-            lua_getglobal(lua_state, "cycle");
-            
-            if (!lua_isfunction(lua_state, -1)) {
-                std::cerr << "[PLC] Error: cycle function not found in Lua script" << std::endl;
-                break;
+                std::cerr << "[PLC] Failed to acquire mutex in cycle " << cycle_count << " of task " << config.name << std::endl;
+            } else {
+                scanned = runCycle(task, cycle_count);
             }
         }
         
-        if (lua_pcall(current_state, 0, 0, 0) != 0) {
-            std::cerr << "[PLC] Lua error in cycle " << cycle_count << ": " 
-                      << lua_tostring(current_state, -1) << std::endl;
-            
-            lua_getglobal(current_state, "debug");
-            if (!lua_isnil(current_state, -1)) {
-                lua_getfield(current_state, -1, "traceback");
-                if (lua_isfunction(current_state, -1)) {
-                    lua_pushstring(current_state, "Stack traceback:");
-                    lua_pcall(current_state, 1, 1, 0);
-                    std::cerr << "[PLC] Lua stack trace: " << lua_tostring(current_state, -1) << std::endl;
-                    lua_pop(current_state, 1);
-                }
-                lua_pop(current_state, 1);
-            }
-            lua_pop(current_state, 1);
-        }
-        
         cycle_count++;
-        std::this_thread::sleep_for(SCAN_INTERVAL);
+        
+        // On overrun the missed deadlines are skipped rather than run back to back
+        uint64_t finished = platform::monotonic_ns();
+        uint64_t scheduled = deadline;
+        deadline += scan_period_ns;
+        uint64_t skipped = 0;
+        if (finished > deadline) {
+            skipped = (finished - deadline) / scan_period_ns + 1;
+            deadline += skipped * scan_period_ns;
+        }
+        // Cycles without a scan (no entry function, mutex timeout) would only skew the histograms
+        if (scanned) {
+            task.statistics.record(finished - started, started > scheduled ? started - scheduled : 0, skipped);
+        }
+        platform::sleep_until_ns(deadline);
     }
 
-    std::cout << "[PLC] Logic thread stopped after " << cycle_count << " cycles.\n";
+    std::cout << "[PLC] Task " << config.name << " stopped after " << cycle_count << " cycles.\n";
+}
+
+bool PlcLogic::runCycle(Task& task, int cycle_count) {
+    lua_State* lua_state = task.lua_state;
+    lua_getglobal(lua_state, task.config.entry.c_str());
+    
+    // The task keeps its schedule without a script, so a reload can bring it back
+    if (!lua_isfunction(lua_state, -1)) {
+        lua_pop(lua_state, 1);
+        if (!task.entry_missing) {
+            std::cerr << "[PLC] Error: " << task.config.entry << " function not found in Lua script; task "
+                      << task.config.name << " is idle until the script is reloaded" << std::endl;
+            task.entry_missing = true;
+        }
+        return false;
+    }
+    if (task.entry_missing) {
+        std::cout << "[PLC] Task " << task.config.name << " found " << task.config.entry << "(), resuming" << std::endl;
+        task.entry_missing = false;
+    }
+    
+    beginScan(task);
+    if (lua_pcall(lua_state, 0, 0, 0) != 0) {
+        std::cerr << "[PLC] Lua error in cycle " << cycle_count << ": " 
+                  << lua_tostring(lua_state, -1) << std::endl;
+        
+        lua_getglobal(lua_state, "debug");
+        if (!lua_isnil(lua_state, -1)) {
+            lua_getfield(lua_state, -1, "traceback");
+            if (lua_isfunction(lua_state, -1)) {
+                lua_pushstring(lua_state, "Stack traceback:");
+                lua_pcall(lua_state, 1, 1, 0);
+                std::cerr << "[PLC] Lua stack trace: " << lua_tostring(lua_state, -1) << std::endl;
+                lua_pop(lua_state, 1);
+            }
+            lua_pop(lua_state, 1);
+        }
+        lua_pop(lua_state, 1);
+    }
+    commitScan(task);
+    return true;
 }
\ No newline at end of file
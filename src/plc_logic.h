@@ -2,21 +2,58 @@
 
 #include <modbus.h>
 #include <thread>
+#include <array>
 #include <atomic>
+#include <memory>
 #include <mutex>
-#include <lua.hpp>
+#include <string>
+#include <vector>
+#include "lua_compat.h"
+#include "device_config.h"
+#include "process_image.h"
+#include "scan_statistics.h"
 
 class PlcLogic {
 public:
-    static void start(modbus_mapping_t* mapping);
+    static void start(ProcessImage* image);
     static void stop();
-    static void loadScript(const std::string& scriptPath);
-    static void reloadScript(const std::string& scriptPath);
+    static void loadScript(const std::string& scriptPath);  // Run a script in every task without a script of its own
+    static std::string getStatistics();  // Scan time and jitter report per task for the server statistics
 
 private:
-    static void loop();
-    static void setupLuaBindings(lua_State* L);
-    
+    // One cyclic task: its own thread, Lua state, scan image and scheduler
+    struct Task {
+        TaskConfig config;
+        std::string script;                  // Script path, resolved from config or run_script
+        std::thread thread;
+        std::timed_mutex script_mutex;       // Guards lua_state and the scan image; the process image has its own lock
+        lua_State* lua_state = nullptr;
+        ProcessImage::Tables scan_inputs;    // Process image as copied at scan start
+        ProcessImage::Tables scan_image;     // Private image the Lua bindings read and write during a scan
+        uint64_t scan_generation = 0;        // Image generation scan_inputs is up to date with
+        bool scan_synced = false;            // False until scan_inputs holds a full copy of the image
+        bool entry_missing = false;          // Entry function absent; reported once until a reload defines it
+        ScanStatistics statistics;           // Scan time, jitter and overruns
+    };
+
+    // Userdata behind image.coil, image.di, image.hr and image.ir: one table of a task's scan image
+    struct ImageProxy {
+        Task* task;
+        ProcessImage::Table table;
+    };
+
+    static void loop(Task& task, bool console);
+    static bool runCycle(Task& task, int cycle_count);  // One scan of the entry function; false if skipped because the script has none
+    static void loadScript(Task& task, const std::string& scriptPath);
+    static void reloadScript(Task& task);
+    static lua_State* newLuaState(Task& task);
+    static void beginScan(Task& task);   // Copy the process image into the scan image
+    static void commitScan(Task& task);  // Write what the scan changed back in one transaction
+    static Task& taskOf(lua_State* L);   // Task whose Lua state is calling a binding
+#ifdef SIMPLEPLC_HAVE_LUAJIT
+    static void bindImageFfi(Task& task, lua_State* L);  // Back image.* with FFI cdata over the scan image
+#endif
+
     static int lua_readCoil(lua_State* L);
     static int lua_writeCoil(lua_State* L);
     static int lua_readDiscreteInput(lua_State* L);
@@ -26,10 +63,22 @@ private:
     static int lua_readInputRegister(lua_State* L);
     static int lua_writeInputRegister(lua_State* L);
     static int lua_writeDiscreteInput(lua_State* L);
-    
+    static int lua_pushFifo(lua_State* L);
+    static int lua_readCoils(lua_State* L);
+    static int lua_writeCoils(lua_State* L);
+    static int lua_readDiscreteInputs(lua_State* L);
+    static int lua_writeDiscreteInputs(lua_State* L);
+    static int lua_readHoldingRegisters(lua_State* L);
+    static int lua_writeHoldingRegisters(lua_State* L);
+    static int lua_readInputRegisters(lua_State* L);
+    static int lua_writeInputRegisters(lua_State* L);
+    static int lua_imageIndex(lua_State* L);     // __index of the image proxies: proxy[address]
+    static int lua_imageNewIndex(lua_State* L);  // __newindex of the image proxies: proxy[address] = value
+
     static std::atomic<bool> running;
-    static std::thread thread;
-    static modbus_mapping_t* mb_mapping;
-    static std::timed_mutex mb_mutex;
-    static lua_State* lua_state;
+    static ProcessImage* process_image;
+    static std::vector<std::unique_ptr<Task>> tasks;
+#ifdef SIMPLEPLC_HAVE_LUAJIT
+    static std::array<std::vector<int32_t>, 4> address_maps;  // Scan image index per Modbus address and table, -1 if unmapped
+#endif
 };
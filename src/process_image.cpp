@@ -0,0 +1,271 @@
+#include "process_image.h"
+#include "bit_kernels.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    size_t table_slot(ProcessImage::Table table) {
+        return static_cast<size_t>(table);
+    }
+
+    bool is_bit_table(ProcessImage::Table table) {
+        return table == ProcessImage::Table::Coils || table == ProcessImage::Table::DiscreteInputs;
+    }
+}
+
+uint8_t* ProcessImage::Tables::bits(Table table) {
+    return table == Table::Coils ? coils.data() : discrete_inputs.data();
+}
+
+const uint8_t* ProcessImage::Tables::bits(Table table) const {
+    return table == Table::Coils ? coils.data() : discrete_inputs.data();
+}
+
+uint16_t* ProcessImage::Tables::registers(Table table) {
+    return table == Table::HoldingRegisters ? holding_registers.data() : input_registers.data();
+}
+
+const uint16_t* ProcessImage::Tables::registers(Table table) const {
+    return table == Table::HoldingRegisters ? holding_registers.data() : input_registers.data();
+}
+
+bool ProcessImage::Tables::bit(Table table, int index) const {
+    if (layout == BitLayout::Packed) {
+        return (bits(table)[index / 8] >> (index % 8)) & 0x01;
+    }
+    return bits(table)[index] != 0;
+}
+
+void ProcessImage::Tables::copy_bits(Table table, int index, int count, uint8_t* values) const {
+    if (layout == BitLayout::Packed) {
+        bit_kernels::extract(bits(table), static_cast<size_t>(index), static_cast<size_t>(count), values);
+    } else {
+        std::memcpy(values, bits(table) + index, static_cast<size_t>(count));
+    }
+}
+
+void ProcessImage::Tables::pack_bits(Table table, int index, int count, uint8_t* packed) const {
+    if (layout == BitLayout::Packed) {
+        // copy() leaves the bits past count alone, so the last byte starts out cleared
+        packed[(count - 1) / 8] = 0;
+        bit_kernels::copy(bits(table), static_cast<size_t>(index), packed, 0, static_cast<size_t>(count));
+    } else {
+        bit_kernels::pack(bits(table) + index, static_cast<size_t>(count), packed);
+    }
+}
+
+void ProcessImage::Tables::store_bits(Table table, int index, int count, const uint8_t* values) {
+    if (layout == BitLayout::Packed) {
+        bit_kernels::insert(values, static_cast<size_t>(count), bits(table), static_cast<size_t>(index));
+    } else {
+        uint8_t* out = bits(table) + index;
+        for (int i = 0; i < count; i++) {
+            out[i] = values[i] ? 1 : 0;
+        }
+    }
+}
+
+void ProcessImage::Tables::store_packed_bits(Table table, int index, int count, const uint8_t* packed) {
+    if (layout == BitLayout::Packed) {
+        bit_kernels::copy(packed, 0, bits(table), static_cast<size_t>(index), static_cast<size_t>(count));
+    } else {
+        bit_kernels::unpack(packed, static_cast<size_t>(count), bits(table) + index);
+    }
+}
+
+ProcessImage::Transaction::Transaction(ProcessImage& image)
+    : image_(image), lock_(image.write_mutex_) {
+    touched_begin_.fill(0);
+    touched_end_.fill(0);
+
+    // Steer readers to the mirror before the primary copy changes
+    uint64_t sequence = image_.sequence_.load(std::memory_order_relaxed) + 1;
+    generation_ = (sequence + 1) / 2;
+    image_.sequence_.store(sequence, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+ProcessImage::Transaction::~Transaction() {
+    // Publish the primary copy, then bring the mirror up to date behind the readers
+    std::atomic_thread_fence(std::memory_order_release);
+    image_.sequence_.store(image_.sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const Tables& primary = image_.copies_[PRIMARY];
+    Tables& mirror = image_.copies_[MIRROR];
+    for (Table table : {Table::Coils, Table::DiscreteInputs, Table::HoldingRegisters, Table::InputRegisters}) {
+        size_t slot = table_slot(table);
+        if (touched_begin_[slot] >= touched_end_[slot]) {
+            continue;
+        }
+        auto begin = static_cast<size_t>(touched_begin_[slot]);
+        auto count = static_cast<size_t>(touched_end_[slot] - touched_begin_[slot]);
+        if (is_bit_table(table) && primary.layout == BitLayout::Packed) {
+            // Whole bytes; the bits sharing them with the range are unchanged and equal in both copies
+            size_t end = (begin + count + 7) / 8;
+            std::memcpy(mirror.bits(table) + begin / 8, primary.bits(table) + begin / 8, end - begin / 8);
+        } else if (is_bit_table(table)) {
+            std::memcpy(mirror.bits(table) + begin, primary.bits(table) + begin, count);
+        } else {
+            std::memcpy(mirror.registers(table) + begin, primary.registers(table) + begin, count * sizeof(uint16_t));
+        }
+    }
+}
+
+void ProcessImage::Transaction::touch(Table table, int index, int count) {
+    size_t slot = table_slot(table);
+    if (count <= 0) {
+        return;
+    }
+
+    // Stamps are stored before the publish, so a reader that sees the new generation sees them too
+    std::atomic<uint64_t>* stamps = image_.block_stamps_[slot].get();
+    for (int block = index / CHANGE_BLOCK; block <= (index + count - 1) / CHANGE_BLOCK; block++) {
+        stamps[block].store(generation_, std::memory_order_relaxed);
+    }
+    image_.table_stamps_[slot].store(generation_, std::memory_order_relaxed);
+
+    if (touched_begin_[slot] >= touched_end_[slot]) {
+        touched_begin_[slot] = index;
+        touched_end_[slot] = index + count;
+    } else {
+        touched_begin_[slot] = std::min(touched_begin_[slot], index);
+        touched_end_[slot] = std::max(touched_end_[slot], index + count);
+    }
+}
+
+bool ProcessImage::Transaction::bit(Table table, int index) const {
+    return image_.copies_[PRIMARY].bit(table, index);
+}
+
+const uint16_t* ProcessImage::Transaction::registers(Table table) const {
+    return image_.copies_[PRIMARY].registers(table);
+}
+
+void ProcessImage::Transaction::write_bits(Table table, int index, int count, const uint8_t* values) {
+    touch(table, index, count);
+    image_.copies_[PRIMARY].store_bits(table, index, count, values);
+}
+
+void ProcessImage::Transaction::write_packed_bits(Table table, int index, int count, const uint8_t* packed) {
+    touch(table, index, count);
+    image_.copies_[PRIMARY].store_packed_bits(table, index, count, packed);
+}
+
+uint16_t* ProcessImage::Transaction::modify_registers(Table table, int index, int count) {
+    touch(table, index, count);
+    return image_.copies_[PRIMARY].registers(table) + index;
+}
+
+ProcessImage::ProcessImage(const std::vector<AddressSegment>& coils,
+                           const std::vector<AddressSegment>& discrete_inputs,
+                           const std::vector<AddressSegment>& holding_registers,
+                           const std::vector<AddressSegment>& input_registers,
+                           const std::vector<AddressSegment>& fifos,
+                           BitLayout bit_layout)
+    : layouts_{SegmentMap(coils), SegmentMap(discrete_inputs), SegmentMap(holding_registers), SegmentMap(input_registers)} {
+    auto bit_storage = [bit_layout](int bits) {
+        return static_cast<size_t>(bit_layout == BitLayout::Packed ? (bits + 7) / 8 : bits);
+    };
+    for (Tables& tables : copies_) {
+        tables.layout = bit_layout;
+        tables.coils.resize(bit_storage(layout(Table::Coils).size()));
+        tables.discrete_inputs.resize(bit_storage(layout(Table::DiscreteInputs).size()));
+        tables.holding_registers.resize(static_cast<size_t>(layout(Table::HoldingRegisters).size()));
+        tables.input_registers.resize(static_cast<size_t>(layout(Table::InputRegisters).size()));
+    }
+
+    for (Table table : {Table::Coils, Table::DiscreteInputs, Table::HoldingRegisters, Table::InputRegisters}) {
+        auto blocks = static_cast<size_t>((size(table) + CHANGE_BLOCK - 1) / CHANGE_BLOCK);
+        block_stamps_[table_slot(table)] = std::make_unique<std::atomic<uint64_t>[]>(blocks);
+    }
+
+    // Kept alive for the loop: segments() refers into the map
+    SegmentMap fifo_layout(fifos);
+    for (const auto& segment : fifo_layout.segments()) {
+        for (int address = segment.start; address < segment.start + segment.count; address++) {
+            fifos_[address] = std::make_unique<FifoQueue>();
+        }
+    }
+}
+
+int ProcessImage::size(Table table) const {
+    return layout(table).size();
+}
+
+const SegmentMap& ProcessImage::layout(Table table) const {
+    return layouts_[table_slot(table)];
+}
+
+bool ProcessImage::translate(Table table, int address, int count, int& index) const {
+    return layout(table).translate(address, count, index);
+}
+
+uint64_t ProcessImage::generation() const {
+    // Every transaction advances the sequence twice
+    return sequence_.load(std::memory_order_acquire) / 2;
+}
+
+bool ProcessImage::changed_since(Table table, int index, int count, uint64_t since) const {
+    size_t slot = table_slot(table);
+    if (table_stamps_[slot].load(std::memory_order_relaxed) <= since) {
+        return false;
+    }
+    int begin = std::max(index, 0);
+    int end = std::min(index + count, size(table));
+    const std::atomic<uint64_t>* stamps = block_stamps_[slot].get();
+    for (int block = begin / CHANGE_BLOCK; begin < end && block <= (end - 1) / CHANGE_BLOCK; block++) {
+        if (stamps[block].load(std::memory_order_relaxed) > since) {
+            return true;
+        }
+    }
+    return false;
+}
+
+FifoQueue* ProcessImage::fifo(int address) {
+    auto it = fifos_.find(address);
+    return it == fifos_.end() ? nullptr : it->second.get();
+}
+
+bool ProcessImage::read_bit(Table table, int address, bool& value) const {
+    int index;
+    if (!translate(table, address, 1, index)) {
+        return false;
+    }
+    read([&](const Tables& tables) {
+        value = tables.bit(table, index);
+    });
+    return true;
+}
+
+bool ProcessImage::write_bit(Table table, int address, bool value) {
+    int index;
+    if (!translate(table, address, 1, index)) {
+        return false;
+    }
+    uint8_t bit = value ? 1 : 0;
+    Transaction transaction(*this);
+    transaction.write_bits(table, index, 1, &bit);
+    return true;
+}
+
+bool ProcessImage::read_register(Table table, int address, uint16_t& value) const {
+    int index;
+    if (!translate(table, address, 1, index)) {
+        return false;
+    }
+    read([&](const Tables& tables) {
+        value = tables.registers(table)[index];
+    });
+    return true;
+}
+
+bool ProcessImage::write_register(Table table, int address, uint16_t value) {
+    int index;
+    if (!translate(table, address, 1, index)) {
+        return false;
+    }
+    Transaction transaction(*this);
+    *transaction.modify_registers(table, index, 1) = value;
+    return true;
+}
@@ -0,0 +1,395 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "fifo_queue.h"
+#include "segment_map.h"
+
+/**
+ * @class ProcessImage
+ * @brief The four Modbus data tables shared by every subsystem
+ *
+ * The Modbus workers, the PLC scan, the Lua world hooks and the OPC UA
+ * server all read and write the same coils and registers. The image owns
+ * that storage and is the only place that synchronizes it.
+ *
+ * The tables are kept twice and versioned by a sequence counter (a
+ * seqlock latch). A write transaction first steers readers to the mirror
+ * copy, updates the primary copy, publishes it as a new generation and
+ * then brings the mirror up to date. Readers never lock: they copy out of
+ * whichever copy the counter selects and only retry if a publish happened
+ * while they were copying. Writers serialize on a mutex among themselves.
+ */
+class ProcessImage {
+public:
+    /**
+     * @brief The four tables of the Modbus data model
+     */
+    enum class Table {
+        Coils,             ///< Read/write bits (0xxxx)
+        DiscreteInputs,    ///< Read-only bits (1xxxx)
+        HoldingRegisters,  ///< Read/write registers (4xxxx)
+        InputRegisters     ///< Read-only registers (3xxxx)
+    };
+
+    /**
+     * @brief Storage of the coil and discrete input tables
+     */
+    enum class BitLayout {
+        Bytes,   ///< One byte per bit, 0 or 1
+        Packed   ///< Eight bits per byte, least significant bit first like the wire format
+    };
+
+    /**
+     * @struct Tables
+     * @brief One copy of the four tables
+     *
+     * Bit tables are stored as selected by layout; the bit accessors below
+     * work with either and should be preferred over bits().
+     */
+    struct Tables {
+        BitLayout layout = BitLayout::Bytes;      ///< Storage of coils and discrete_inputs
+        std::vector<uint8_t> coils;               ///< Coil storage
+        std::vector<uint8_t> discrete_inputs;     ///< Discrete input storage
+        std::vector<uint16_t> holding_registers;  ///< Holding register storage
+        std::vector<uint16_t> input_registers;    ///< Input register storage
+
+        uint8_t* bits(Table table);               ///< Raw storage of a bit table, see layout
+        const uint8_t* bits(Table table) const;   ///< Raw storage of a bit table, see layout
+        uint16_t* registers(Table table);
+        const uint16_t* registers(Table table) const;
+
+        /**
+         * @brief Read one bit
+         *
+         * @param table Coils or DiscreteInputs
+         * @param index Table index
+         * @return Bit value
+         */
+        bool bit(Table table, int index) const;
+
+        /**
+         * @brief Copy a range of bits out one byte per bit
+         *
+         * @param table Coils or DiscreteInputs
+         * @param index First table index
+         * @param count Number of bits
+         * @param values Receives count bytes, each 0 or 1
+         */
+        void copy_bits(Table table, int index, int count, uint8_t* values) const;
+
+        /**
+         * @brief Copy a range of bits out in wire format
+         *
+         * @param table Coils or DiscreteInputs
+         * @param index First table index
+         * @param count Number of bits
+         * @param packed Receives (count + 7) / 8 bytes; unused high bits of the last byte are cleared
+         */
+        void pack_bits(Table table, int index, int count, uint8_t* packed) const;
+
+        /**
+         * @brief Store a range of bits given one byte per bit
+         *
+         * @param table Coils or DiscreteInputs
+         * @param index First table index
+         * @param count Number of bits
+         * @param values One byte per bit, any non-zero byte counts as set
+         */
+        void store_bits(Table table, int index, int count, const uint8_t* values);
+
+        /**
+         * @brief Store a range of bits given in wire format
+         *
+         * @param table Coils or DiscreteInputs
+         * @param index First table index
+         * @param count Number of bits
+         * @param packed (count + 7) / 8 bytes, least significant bit first
+         */
+        void store_packed_bits(Table table, int index, int count, const uint8_t* packed);
+    };
+
+    /**
+     * @class Transaction
+     * @brief Exclusive write access to the image, published when it ends
+     *
+     * Every entry written with write_bits() or handed out by
+     * modify_registers() is copied to the mirror on publish, so entries must
+     * not be changed through any other path. Other threads observe the transaction as a
+     * whole or not at all.
+     */
+    class Transaction {
+    public:
+        /**
+         * @brief Begin a transaction; blocks while another one is open
+         *
+         * @param image Image to modify
+         */
+        explicit Transaction(ProcessImage& image);
+
+        /**
+         * @brief Publish the changes as a new generation
+         */
+        ~Transaction();
+
+        Transaction(const Transaction&) = delete;
+        Transaction& operator=(const Transaction&) = delete;
+
+        /**
+         * @brief Current value of a bit, including changes made in this transaction
+         *
+         * @param table Coils or DiscreteInputs
+         * @param index Table index
+         * @return Bit value
+         */
+        bool bit(Table table, int index) const;
+
+        /**
+         * @brief Current register values, including changes made in this transaction
+         *
+         * @param table HoldingRegisters or InputRegisters
+         * @return First entry of the table
+         */
+        const uint16_t* registers(Table table) const;
+
+        /**
+         * @brief Write a range of bits given one byte per bit
+         *
+         * @param table Coils or DiscreteInputs
+         * @param index First entry to modify; the range must lie inside the table
+         * @param count Number of entries to modify
+         * @param values One byte per bit, any non-zero byte counts as set
+         */
+        void write_bits(Table table, int index, int count, const uint8_t* values);
+
+        /**
+         * @brief Write a range of bits given in wire format
+         *
+         * @param table Coils or DiscreteInputs
+         * @param index First entry to modify; the range must lie inside the table
+         * @param count Number of entries to modify
+         * @param packed (count + 7) / 8 bytes, least significant bit first
+         */
+        void write_packed_bits(Table table, int index, int count, const uint8_t* packed);
+
+        /**
+         * @brief Get write access to a range of registers
+         *
+         * @param table HoldingRegisters or InputRegisters
+         * @param index First entry to modify; the range must lie inside the table
+         * @param count Number of entries to modify
+         * @return Pointer to the entry at index
+         */
+        uint16_t* modify_registers(Table table, int index, int count);
+
+    private:
+        /**
+         * @brief Extend the range of a table copied to the mirror on publish
+         *        and stamp its change blocks with this generation
+         */
+        void touch(Table table, int index, int count);
+
+        ProcessImage& image_;                   ///< Image being modified
+        std::lock_guard<std::mutex> lock_;      ///< Writer lock
+        uint64_t generation_;                   ///< Generation this transaction publishes
+        std::array<int, 4> touched_begin_;      ///< First modified entry per table
+        std::array<int, 4> touched_end_;        ///< One past the last modified entry per table
+    };
+
+    /**
+     * @brief Constructor - allocates every table zero-filled
+     *
+     * @param coils Coil address blocks
+     * @param discrete_inputs Discrete input address blocks
+     * @param holding_registers Holding register address blocks
+     * @param input_registers Input register address blocks
+     * @param fifos FIFO pointer addresses, one queue per address
+     * @param bit_layout Storage of the coil and discrete input tables
+     */
+    ProcessImage(const std::vector<AddressSegment>& coils,
+                 const std::vector<AddressSegment>& discrete_inputs,
+                 const std::vector<AddressSegment>& holding_registers,
+                 const std::vector<AddressSegment>& input_registers,
+                 const std::vector<AddressSegment>& fifos = {},
+                 BitLayout bit_layout = BitLayout::Bytes);
+
+    ProcessImage(const ProcessImage&) = delete;
+    ProcessImage& operator=(const ProcessImage&) = delete;
+
+    /**
+     * @brief Get the number of entries in a table
+     *
+     * @param table Table to query
+     * @return Number of bits or registers
+     */
+    int size(Table table) const;
+
+    /**
+     * @brief Get the address layout of a table
+     *
+     * @param table Table to query
+     * @return Segment map translating Modbus addresses into table indices
+     */
+    const SegmentMap& layout(Table table) const;
+
+    /**
+     * @brief Translate a Modbus address range into a table index
+     *
+     * @param table Table to query
+     * @param address First Modbus address
+     * @param count Number of addresses; all of them must lie in one address block
+     * @param index Receives the table index of address
+     * @return false if any address of the range is not mapped
+     */
+    bool translate(Table table, int address, int count, int& index) const;
+
+    /**
+     * @brief Number of transactions published so far
+     *
+     * @return Generation of the current image
+     */
+    uint64_t generation() const;
+
+    /**
+     * @brief Check whether a range of entries was modified after a generation
+     *
+     * Tracking is per block of CHANGE_BLOCK entries, so neighbours of a
+     * modified entry report a change too.
+     *
+     * @param table Table to query
+     * @param index First table index, see translate()
+     * @param count Number of entries
+     * @param since Generation the caller is up to date with
+     * @return true if a transaction after since modified a block of the range
+     */
+    bool changed_since(Table table, int index, int count, uint64_t since) const;
+
+    /**
+     * @brief Visit the ranges of a table modified after a generation
+     *
+     * Take generation() before the call and pass it as since next time;
+     * ranges published meanwhile are then reported again rather than missed.
+     *
+     * @param table Table to query
+     * @param since Generation the caller is up to date with
+     * @param changed Called as changed(index, count) for each run of modified blocks
+     */
+    template <typename Changed>
+    void for_each_change(Table table, uint64_t since, Changed&& changed) const {
+        auto slot = static_cast<size_t>(table);
+        if (table_stamps_[slot].load(std::memory_order_relaxed) <= since) {
+            return;
+        }
+        const std::atomic<uint64_t>* stamps = block_stamps_[slot].get();
+        int blocks = (size(table) + CHANGE_BLOCK - 1) / CHANGE_BLOCK;
+        int block = 0;
+        while (block < blocks) {
+            if (stamps[block].load(std::memory_order_relaxed) <= since) {
+                block++;
+                continue;
+            }
+            int end = block + 1;
+            while (end < blocks && stamps[end].load(std::memory_order_relaxed) > since) {
+                end++;
+            }
+            int index = block * CHANGE_BLOCK;
+            changed(index, std::min(end * CHANGE_BLOCK, size(table)) - index);
+            block = end;
+        }
+    }
+
+    /**
+     * @brief Read a consistent view of the image without locking
+     *
+     * The reader may be called more than once if a transaction is published
+     * while it runs; only its last call saw a consistent image. It must only
+     * copy data out and must not keep pointers into the tables.
+     *
+     * @param read Called as read(const Tables&)
+     */
+    template <typename Read>
+    void read(Read&& read) const {
+        for (;;) {
+            uint64_t sequence = sequence_.load(std::memory_order_acquire);
+            read(copies_[sequence & 1]);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == sequence) {
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Read one bit
+     *
+     * @param table Coils or DiscreteInputs
+     * @param address Modbus address
+     * @param value Receives the bit
+     * @return false if the address is not mapped
+     */
+    bool read_bit(Table table, int address, bool& value) const;
+
+    /**
+     * @brief Write one bit in its own transaction
+     *
+     * @param table Coils or DiscreteInputs
+     * @param address Modbus address
+     * @param value New value
+     * @return false if the address is not mapped
+     */
+    bool write_bit(Table table, int address, bool value);
+
+    /**
+     * @brief Read one register
+     *
+     * @param table HoldingRegisters or InputRegisters
+     * @param address Modbus address
+     * @param value Receives the register
+     * @return false if the address is not mapped
+     */
+    bool read_register(Table table, int address, uint16_t& value) const;
+
+    /**
+     * @brief Write one register in its own transaction
+     *
+     * @param table HoldingRegisters or InputRegisters
+     * @param address Modbus address
+     * @param value New value
+     * @return false if the address is not mapped
+     */
+    bool write_register(Table table, int address, uint16_t value);
+
+    /**
+     * @brief Get the queue behind a FIFO pointer address
+     *
+     * FIFO queues live outside the four tables and their transactions;
+     * samples are pushed and popped directly.
+     *
+     * @param address FIFO pointer address
+     * @return Queue, or nullptr if no FIFO is configured at the address
+     */
+    FifoQueue* fifo(int address);
+
+    /// Entries per change-tracking block
+    static constexpr int CHANGE_BLOCK = 64;
+
+private:
+    /// Copy written by transactions
+    static constexpr size_t PRIMARY = 0;
+
+    /// Copy readers fall back to while a transaction is open
+    static constexpr size_t MIRROR = 1;
+
+    std::array<SegmentMap, 4> layouts_;       ///< Address layout per table, indexed by Table
+    std::array<Tables, 2> copies_;            ///< Primary and mirror copy of the tables
+    std::atomic<uint64_t> sequence_{0};       ///< Even: readers use the primary; odd: the mirror
+    std::array<std::unique_ptr<std::atomic<uint64_t>[]>, 4> block_stamps_;  ///< Last generation that modified each block
+    std::array<std::atomic<uint64_t>, 4> table_stamps_{};                    ///< Last generation that modified each table
+    std::mutex write_mutex_;                  ///< Serializes transactions
+    std::unordered_map<int, std::unique_ptr<FifoQueue>> fifos_;  ///< FIFO queues by pointer address, fixed after construction
+};
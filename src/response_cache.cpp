@@ -0,0 +1,54 @@
+#include "response_cache.h"
+#include <cstring>
+
+int ResponseCache::lookup(const uint8_t* query, const ProcessImage& image, ProcessImage::Table table,
+                          int index, int count, uint8_t* pdu) {
+    uint64_t key = key_of(query);
+    Slot& slot = slot_of(key);
+    {
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        if (slot.key == key && slot.table == table && slot.index == index && slot.count == count &&
+            !image.changed_since(table, index, count, slot.generation)) {
+            std::memcpy(pdu, slot.pdu.data(), static_cast<size_t>(slot.length));
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return slot.length;
+        }
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
+
+void ResponseCache::store(const uint8_t* query, uint64_t generation, ProcessImage::Table table,
+                          int index, int count, const uint8_t* pdu, int length) {
+    if (length <= 0 || static_cast<size_t>(length) > MAX_PDU) {
+        return;
+    }
+    uint64_t key = key_of(query);
+    Slot& slot = slot_of(key);
+    std::lock_guard<std::mutex> lock(slot.mutex);
+    // Keep whichever encoding is newer if two workers missed on the same request
+    if (slot.key == key && slot.generation > generation) {
+        return;
+    }
+    slot.key = key;
+    slot.generation = generation;
+    slot.table = table;
+    slot.index = index;
+    slot.count = count;
+    slot.length = length;
+    std::memcpy(slot.pdu.data(), pdu, static_cast<size_t>(length));
+}
+
+uint64_t ResponseCache::key_of(const uint8_t* query) {
+    // Bytes 6-11: unit ID, function code, address, count
+    uint64_t key = 1;
+    for (size_t i = 6; i < 12; i++) {
+        key = (key << 8) | query[i];
+    }
+    return key;
+}
+
+ResponseCache::Slot& ResponseCache::slot_of(uint64_t key) {
+    // Fibonacci hashing spreads neighbouring addresses over the slots
+    return slots_[static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 58) % SLOTS];
+}
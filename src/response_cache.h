@@ -0,0 +1,104 @@
+#pragma once
+#include <modbus.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "process_image.h"
+
+/**
+ * @class ResponseCache
+ * @brief Encoded read responses shared by all workers
+ *
+ * Many HMIs poll the same block at the same rate, so the same bytes get
+ * encoded over and over. The cache keeps the PDU of recent read responses
+ * keyed by unit ID, function code, address and count, together with the
+ * image generation they were encoded at. A hit is only served while no
+ * transaction has modified the range since, so it costs a stamp check and
+ * a copy instead of an image read and an encode.
+ *
+ * The cache is direct-mapped; each slot has its own lock, held only while
+ * a PDU is copied in or out.
+ */
+class ResponseCache {
+public:
+    /// Number of cached responses
+    static constexpr size_t SLOTS = 64;
+
+    /// Largest read PDU: function code, byte count and 125 registers or 2000 bits
+    static constexpr size_t MAX_PDU = 2 + 2 * MODBUS_MAX_READ_REGISTERS;
+
+    /**
+     * @brief Copy out the cached response to a read request if it is still current
+     *
+     * @param query Complete request ADU, MBAP header included
+     * @param image Process image the response was encoded from
+     * @param table Table the request reads
+     * @param index Table index of the first address read
+     * @param count Number of entries read
+     * @param pdu Receives the response PDU, at least MAX_PDU bytes
+     * @return Length of the PDU, 0 on a miss
+     */
+    int lookup(const uint8_t* query, const ProcessImage& image, ProcessImage::Table table,
+               int index, int count, uint8_t* pdu);
+
+    /**
+     * @brief Remember the response to a read request
+     *
+     * @param query Complete request ADU, MBAP header included
+     * @param generation Image generation taken before the response was encoded
+     * @param table Table the request reads
+     * @param index Table index of the first address read
+     * @param count Number of entries read
+     * @param pdu Response PDU
+     * @param length Length of the PDU; longer ones are not cached
+     */
+    void store(const uint8_t* query, uint64_t generation, ProcessImage::Table table,
+               int index, int count, const uint8_t* pdu, int length);
+
+    /**
+     * @brief Number of requests answered from the cache
+     * @return Hit count since start
+     */
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Number of lookups that had to encode the response
+     * @return Miss count since start
+     */
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+    /**
+     * @struct Slot
+     * @brief One cached response
+     */
+    struct Slot {
+        std::mutex mutex;                          ///< Guards the fields below
+        uint64_t key = 0;                          ///< Unit, function, address and count; 0 = empty
+        uint64_t generation = 0;                   ///< Image generation the PDU was encoded at
+        ProcessImage::Table table = ProcessImage::Table::Coils;  ///< Table the PDU was read from
+        int index = 0;                             ///< First table index read
+        int count = 0;                             ///< Number of entries read
+        int length = 0;                            ///< PDU length
+        std::array<uint8_t, MAX_PDU> pdu{};        ///< Encoded response PDU
+    };
+
+    /**
+     * @brief Build the cache key of a request
+     *
+     * @param query Complete request ADU, MBAP header included
+     * @return Unit ID, function code, address and count, with a marker bit so it is never 0
+     */
+    static uint64_t key_of(const uint8_t* query);
+
+    /**
+     * @brief Get the slot a key maps to
+     */
+    Slot& slot_of(uint64_t key);
+
+    std::array<Slot, SLOTS> slots_;              ///< Cached responses
+    std::atomic<uint64_t> hits_{0};              ///< Requests answered from the cache
+    std::atomic<uint64_t> misses_{0};            ///< Lookups that found nothing current
+};
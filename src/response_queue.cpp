@@ -0,0 +1,89 @@
+#include "platform.h"  // Include platform.h first for platform-specific definitions
+#include "response_queue.h"
+#include <cerrno>
+
+uint8_t* ResponseQueue::reserve() {
+    if (full()) {
+        return nullptr;
+    }
+    return buffer_ + count_ * MODBUS_TCP_MAX_ADU_LENGTH;
+}
+
+void ResponseQueue::commit(size_t length) {
+    if (length == 0 || full()) {
+        return;
+    }
+    segments_[count_] = Segment{count_ * MODBUS_TCP_MAX_ADU_LENGTH, length};
+    count_++;
+}
+
+#ifndef _WIN32
+const struct msghdr* ResponseQueue::prepare_message() {
+    size_t iov_count = 0;
+    for (size_t i = first_; i < count_; i++) {
+        size_t skip = (i == first_) ? sent_ : 0;
+        iov_[iov_count].iov_base = buffer_ + segments_[i].offset + skip;
+        iov_[iov_count].iov_len = segments_[i].length - skip;
+        iov_count++;
+    }
+    
+    message_ = {};
+    message_.msg_iov = iov_;
+    message_.msg_iovlen = iov_count;
+    return &message_;
+}
+#endif
+
+void ResponseQueue::complete(size_t bytes) {
+    while (bytes > 0 && first_ < count_) {
+        size_t remaining = segments_[first_].length - sent_;
+        if (bytes < remaining) {
+            sent_ += bytes;
+            return;
+        }
+        bytes -= remaining;
+        sent_ = 0;
+        first_++;
+    }
+    
+    if (first_ == count_) {
+        // Everything went out; start filling the buffer from the beginning again
+        first_ = 0;
+        count_ = 0;
+        sent_ = 0;
+    }
+}
+
+ResponseQueue::FlushResult ResponseQueue::flush(int socket) {
+    while (!empty()) {
+#ifdef _WIN32
+        // No gather write for plain sockets here; send segment by segment
+        const Segment& segment = segments_[first_];
+        int n = ::send(socket, reinterpret_cast<const char*>(buffer_ + segment.offset + sent_),
+                       static_cast<int>(segment.length - sent_), 0);
+        if (n == SOCKET_ERROR) {
+            int error = WSAGetLastError();
+            if (error == WSAEWOULDBLOCK) {
+                return FlushResult::Pending;
+            }
+            if (error == WSAEINTR) {
+                continue;
+            }
+            return FlushResult::Error;
+        }
+#else
+        ssize_t n = ::sendmsg(socket, prepare_message(), MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return FlushResult::Pending;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return FlushResult::Error;
+        }
+#endif
+        complete(static_cast<size_t>(n));
+    }
+    return FlushResult::Done;
+}
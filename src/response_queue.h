@@ -0,0 +1,117 @@
+#pragma once
+#include <modbus.h>
+#include <cstddef>
+#include <cstdint>
+
+#ifndef _WIN32
+#include <sys/socket.h>  // For msghdr
+#include <sys/uio.h>     // For iovec
+#endif
+
+/**
+ * @class ResponseQueue
+ * @brief Per-connection queue of encoded responses flushed with one gather write
+ * 
+ * Responses to pipelined requests are encoded into a fixed buffer one after
+ * another and sent together with a single sendmsg() (scatter/gather over one
+ * segment per response). Bytes the socket could not take are kept and sent
+ * first on the next flush, so responses always leave in request order.
+ */
+class ResponseQueue {
+public:
+    /// Maximum number of responses queued before a flush is required
+    static constexpr size_t MAX_RESPONSES = 16;
+    
+    /// Storage for queued responses
+    static constexpr size_t BUFFER_SIZE = MAX_RESPONSES * MODBUS_TCP_MAX_ADU_LENGTH;
+    
+    /**
+     * @brief Result of a flush attempt
+     */
+    enum class FlushResult {
+        Done,     ///< Everything queued was sent
+        Pending,  ///< The socket buffer is full; wait for writability and flush again
+        Error     ///< A socket error occurred
+    };
+    
+    /**
+     * @brief Get space for one more response of up to MODBUS_TCP_MAX_ADU_LENGTH bytes
+     * 
+     * @return Pointer to write the response into, or nullptr if the queue is full
+     */
+    uint8_t* reserve();
+    
+    /**
+     * @brief Queue the response written into the last reserve()d space
+     * 
+     * @param length Response length in bytes, 0 to drop it
+     */
+    void commit(size_t length);
+    
+    /**
+     * @brief Check whether another response can be queued
+     * 
+     * @return true if reserve() would fail
+     */
+    bool full() const { return count_ == MAX_RESPONSES; }
+    
+    /**
+     * @brief Check whether any response bytes are waiting to be sent
+     * 
+     * @return true if nothing is queued
+     */
+    bool empty() const { return first_ == count_; }
+    
+    /**
+     * @brief Send as much of the queue as the socket accepts
+     * 
+     * @param socket Non-blocking client socket
+     * @return Outcome of the flush
+     */
+    FlushResult flush(int socket);
+    
+#ifndef _WIN32
+    /**
+     * @brief Describe all unsent bytes as a message for an asynchronous sender
+     * 
+     * The message refers to storage owned by the queue and stays valid until
+     * complete() is called. Responses committed in the meantime are not part
+     * of it and go out with the next message.
+     * 
+     * @return Message covering every unsent byte
+     */
+    const struct msghdr* prepare_message();
+#endif
+    
+    /**
+     * @brief Mark bytes as sent
+     * 
+     * @param bytes Number of bytes the socket accepted
+     */
+    void complete(size_t bytes);
+    
+    /**
+     * @brief Drop every queued response so the queue can serve a new connection
+     */
+    void reset() { count_ = 0; first_ = 0; sent_ = 0; }
+    
+private:
+    /**
+     * @brief One queued response
+     */
+    struct Segment {
+        size_t offset;  ///< Start of the response in buffer_
+        size_t length;  ///< Response length in bytes
+    };
+    
+    uint8_t buffer_[BUFFER_SIZE];       ///< Encoded responses
+    Segment segments_[MAX_RESPONSES];   ///< Queued responses in request order
+    size_t count_ = 0;                  ///< Number of queued responses
+    size_t first_ = 0;                  ///< First response not completely sent
+    size_t sent_ = 0;                   ///< Bytes of segments_[first_] already sent
+    
+#ifndef _WIN32
+    struct iovec iov_[MAX_RESPONSES];   ///< Gather list for the pending message
+    struct msghdr message_{};           ///< Message returned by prepare_message()
+#endif
+};
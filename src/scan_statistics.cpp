@@ -0,0 +1,78 @@
+#include "scan_statistics.h"
+#include <algorithm>
+#include <bit>
+#include <sstream>
+
+void ScanStatistics::record(uint64_t scan_ns, uint64_t jitter_ns, uint64_t skipped) {
+    scan_time_.record(scan_ns / 1000);
+    jitter_.record(jitter_ns / 1000);
+    if (skipped > 0) {
+        overruns_.fetch_add(1, std::memory_order_relaxed);
+        skipped_.fetch_add(skipped, std::memory_order_relaxed);
+    }
+}
+
+std::string ScanStatistics::report(const std::string& task, uint64_t period_ns) const {
+    std::ostringstream oss;
+    oss << "PLC Task " << task << " Statistics:" << std::endl;
+    oss << "  Period: " << period_ns / 1000 << " us" << std::endl;
+    oss << "  Scans: " << scan_time_.count() << std::endl;
+    oss << "  Overruns: " << overruns_.load(std::memory_order_relaxed)
+        << " (" << skipped_.load(std::memory_order_relaxed) << " periods skipped)" << std::endl;
+    oss << "  Scan time (us): min " << scan_time_.min() << " / avg " << scan_time_.average()
+        << " / max " << scan_time_.max() << " / p99 " << scan_time_.percentile(99) << std::endl;
+    oss << "  Jitter (us): min " << jitter_.min() << " / avg " << jitter_.average()
+        << " / max " << jitter_.max() << " / p99 " << jitter_.percentile(99) << std::endl;
+    return oss.str();
+}
+
+void ScanStatistics::Histogram::record(uint64_t us) {
+    // Single writer, so plain load/store pairs are enough for the extremes
+    buckets_[bucket_of(us)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(us, std::memory_order_relaxed);
+    if (us < min_.load(std::memory_order_relaxed)) {
+        min_.store(us, std::memory_order_relaxed);
+    }
+    if (us > max_.load(std::memory_order_relaxed)) {
+        max_.store(us, std::memory_order_relaxed);
+    }
+    count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t ScanStatistics::Histogram::percentile(unsigned percent) const {
+    uint64_t total = 0;
+    for (const auto& bucket : buckets_) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0;
+    }
+    // Rank of the sample at the percentile, rounded up
+    uint64_t rank = (total * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return std::min(upper_bound(i), max());
+        }
+    }
+    return max();
+}
+
+size_t ScanStatistics::Histogram::bucket_of(uint64_t us) {
+    if (us < 16) {
+        return static_cast<size_t>(us);
+    }
+    auto exponent = static_cast<unsigned>(std::bit_width(us) - 1);
+    auto sub = static_cast<size_t>((us >> (exponent - 4)) & 15);
+    return 16 + (exponent - 4) * 16 + sub;
+}
+
+uint64_t ScanStatistics::Histogram::upper_bound(size_t bucket) {
+    if (bucket < 16) {
+        return bucket;
+    }
+    unsigned shift = static_cast<unsigned>((bucket - 16) / 16);
+    uint64_t lower = (16 + (bucket - 16) % 16) << shift;
+    return lower + ((uint64_t{1} << shift) - 1);
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @class ScanStatistics
+ * @brief Execution time and start jitter of the cyclic PLC scan
+ *
+ * Samples go into log-linear histograms (16 buckets per power of two, in
+ * microseconds), so percentiles cost no allocation and are accurate to
+ * about 6%. Recorded by the scan thread, reported from any thread.
+ */
+class ScanStatistics {
+public:
+    /**
+     * @brief Record one scan
+     *
+     * @param scan_ns Time from scan start to the end of its commit
+     * @param jitter_ns How late the scan started after its deadline
+     * @param skipped Deadlines that passed while the scan ran and were skipped
+     */
+    void record(uint64_t scan_ns, uint64_t jitter_ns, uint64_t skipped);
+
+    /**
+     * @brief Format the statistics for the server statistics output
+     *
+     * @param task Name of the task the scans belong to
+     * @param period_ns Configured scan period
+     * @return Multi-line report
+     */
+    std::string report(const std::string& task, uint64_t period_ns) const;
+
+private:
+    /**
+     * @class Histogram
+     * @brief Distribution of one measurement in microseconds
+     */
+    class Histogram {
+    public:
+        void record(uint64_t us);
+        uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+        uint64_t min() const { return count() ? min_.load(std::memory_order_relaxed) : 0; }
+        uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+        uint64_t average() const { return count() ? sum_.load(std::memory_order_relaxed) / count() : 0; }
+
+        /**
+         * @brief Upper bound of the bucket holding a percentile
+         * @param percent Percentile, e.g. 99
+         */
+        uint64_t percentile(unsigned percent) const;
+
+    private:
+        /// Exact buckets for 0-15 us, then 16 per power of two up to 2^64 us
+        static constexpr size_t BUCKETS = 16 + 60 * 16;
+
+        static size_t bucket_of(uint64_t us);
+        static uint64_t upper_bound(size_t bucket);
+
+        std::array<std::atomic<uint64_t>, BUCKETS> buckets_{};  ///< Samples per bucket
+        std::atomic<uint64_t> count_{0};                        ///< Number of samples
+        std::atomic<uint64_t> sum_{0};                          ///< Sum of all samples
+        std::atomic<uint64_t> min_{UINT64_MAX};                 ///< Smallest sample
+        std::atomic<uint64_t> max_{0};                          ///< Largest sample
+    };
+
+    Histogram scan_time_;               ///< Scan execution time
+    Histogram jitter_;                  ///< Scan start lateness
+    std::atomic<uint64_t> overruns_{0}; ///< Scans that ran past the next deadline
+    std::atomic<uint64_t> skipped_{0};  ///< Deadlines skipped after overruns
+};
@@ -0,0 +1,53 @@
+#include "segment_map.h"
+#include <algorithm>
+
+SegmentMap::SegmentMap(std::vector<AddressSegment> segments) {
+    std::sort(segments.begin(), segments.end(), [](const AddressSegment& a, const AddressSegment& b) {
+        return a.start < b.start;
+    });
+
+    for (const auto& segment : segments) {
+        int start = std::max(segment.start, 0);
+        int end = std::min(segment.start + std::max(segment.count, 0), ADDRESS_SPACE);
+        if (start >= end) {
+            continue;
+        }
+        if (!segments_.empty() && start <= segments_.back().start + segments_.back().count) {
+            AddressSegment& last = segments_.back();
+            last.count = std::max(last.count, end - last.start);
+        } else {
+            segments_.push_back({start, end - start});
+        }
+    }
+
+    for (const auto& segment : segments_) {
+        offsets_.push_back(size_);
+        size_ += segment.count;
+    }
+
+    pages_.resize(ADDRESS_SPACE >> PAGE_BITS);
+    size_t next = 0;
+    for (size_t page = 0; page < pages_.size(); page++) {
+        int page_start = static_cast<int>(page << PAGE_BITS);
+        while (next < segments_.size() && segments_[next].start + segments_[next].count <= page_start) {
+            next++;
+        }
+        pages_[page] = static_cast<uint32_t>(next);
+    }
+}
+
+bool SegmentMap::translate(int address, int count, int& index) const {
+    if (address < 0 || address >= ADDRESS_SPACE || count < 1) {
+        return false;
+    }
+    size_t s = pages_[static_cast<size_t>(address) >> PAGE_BITS];
+    while (s < segments_.size() && segments_[s].start + segments_[s].count <= address) {
+        s++;
+    }
+    if (s == segments_.size() || address < segments_[s].start ||
+        address + count > segments_[s].start + segments_[s].count) {
+        return false;
+    }
+    index = offsets_[s] + (address - segments_[s].start);
+    return true;
+}
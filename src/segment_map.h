@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "device_config.h"
+
+/**
+ * @class SegmentMap
+ * @brief Translates Modbus addresses of one table into dense storage indices
+ *
+ * A table is made of address blocks (segments) laid out back to back in its
+ * storage, so memory scales with the addresses actually configured rather
+ * than with the highest one. The 16-bit address space is split into pages
+ * of 64 addresses, each remembering the first segment that reaches it, so a
+ * lookup costs one table read plus a step over any other segment that ends
+ * in the same page.
+ */
+class SegmentMap {
+public:
+    /// Size of the Modbus address space
+    static constexpr int ADDRESS_SPACE = 65536;
+
+    /**
+     * @brief Constructor
+     *
+     * Overlapping and adjacent segments are merged; addresses outside the
+     * 16-bit address space are dropped.
+     *
+     * @param segments Address blocks in any order
+     */
+    explicit SegmentMap(std::vector<AddressSegment> segments);
+
+    /**
+     * @brief Get the number of addresses in all segments
+     *
+     * @return Number of storage entries the table needs
+     */
+    int size() const { return size_; }
+
+    /**
+     * @brief Get the merged segments in address order
+     *
+     * @return Segments; their entries are stored in this order
+     */
+    const std::vector<AddressSegment>& segments() const { return segments_; }
+
+    /**
+     * @brief Translate an address range that must lie inside one segment
+     *
+     * @param address First Modbus address
+     * @param count Number of addresses, at least 1
+     * @param index Receives the storage index of address
+     * @return false if any address of the range is not mapped
+     */
+    bool translate(int address, int count, int& index) const;
+
+private:
+    /// log2 of the number of addresses per page
+    static constexpr unsigned PAGE_BITS = 6;
+
+    std::vector<AddressSegment> segments_;  ///< Merged segments in address order
+    std::vector<int> offsets_;              ///< Storage index of the first entry of each segment
+    std::vector<uint32_t> pages_;           ///< First segment ending after each page start
+    int size_ = 0;                          ///< Total number of entries
+};
@@ -12,7 +12,12 @@
 #include <netinet/in.h>  // For sockaddr_in definition
 #include <netinet/tcp.h> // For TCP_NODELAY
 #include <arpa/inet.h>   // For inet_ntop and related functions
-#else
+#include <sys/resource.h> // For getrlimit
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>   // For the edge-triggered event loop
+#endif
+#ifdef _WIN32
 // Windows equivalents are already included in platform.h
 #include <io.h>  // For _dup
 #define dup _dup
@@ -27,358 +32,825 @@
 #include <cerrno>
 #include <cstring>
 
-// Constants for configuration - now loaded from settings.ini
+// Event loop tuning constants
 namespace {
-    constexpr int DEFAULT_CLIENT_TIMEOUT_SEC = 1;
-    constexpr int DEFAULT_CLIENT_TIMEOUT_USEC = 0;
+    constexpr int EVENT_LOOP_TIMEOUT_MS = 100;  // Upper bound for noticing server_running changes
+    constexpr auto STATS_INTERVAL = std::chrono::minutes(1);
+#ifdef __linux__
+    constexpr int MAX_EPOLL_EVENTS = 256;
+#endif
+    constexpr size_t UNLIMITED_CONNECTION_SLOTS = 65536;  // Table size when the descriptor limit is unknown or unlimited
+    constexpr size_t DESCRIPTOR_HEADROOM = 1024;          // Descriptors assumed to be in use besides client sockets
+
+    /**
+     * Earliest time a connection has to be checked again by the reaper, or 0
+     * if no timeout applies. The check itself decides whether it expired.
+     */
+    uint64_t reaper_deadline(ClientConnection& connection, uint64_t now_ms) {
+        const auto& config = DeviceConfig::getModbusConfig();
+        uint64_t deadline = 0;
+        if (config.idle_timeout_ms > 0) {
+            deadline = connection.getLastRequestTime() + static_cast<uint64_t>(config.idle_timeout_ms);
+        }
+        if (config.frame_timeout_ms > 0) {
+            uint64_t frame_timeout = static_cast<uint64_t>(config.frame_timeout_ms);
+            // Without a partial frame yet, look again one timeout from now
+            uint64_t frame_deadline = connection.getPartialFrameTime() != 0 
+                                    ? connection.getPartialFrameTime() + frame_timeout 
+                                    : now_ms + frame_timeout;
+            deadline = deadline == 0 ? frame_deadline : std::min(deadline, frame_deadline);
+        }
+        return deadline;
+    }
+
+    /**
+     * Number of slots in the connection table. Descriptors are handed out
+     * lowest first, so client sockets stay below max_connections plus the
+     * descriptors used otherwise; connection_slots overrides that estimate.
+     * Never more than the process may open.
+     */
+    size_t connection_table_size(const ModbusServerConfig& config) {
+        size_t limit = UNLIMITED_CONNECTION_SLOTS;
+#ifndef _WIN32
+        struct rlimit descriptors{};
+        if (getrlimit(RLIMIT_NOFILE, &descriptors) == 0 && descriptors.rlim_cur != RLIM_INFINITY) {
+            limit = static_cast<size_t>(descriptors.rlim_cur);
+        }
+#endif
+        if (config.connection_slots > 0) {
+            return std::min(static_cast<size_t>(config.connection_slots), limit);
+        }
+        if (config.max_connections > 0) {
+            return std::min(static_cast<size_t>(config.max_connections) + DESCRIPTOR_HEADROOM, limit);
+        }
+        return limit;
+    }
+
+    /**
+     * Address blocks of one table: the configured ones, or 0 .. mapping_size-1
+     * when the table has no list of its own.
+     */
+    std::vector<AddressSegment> table_layout(const std::vector<AddressSegment>& configured) {
+        if (!configured.empty()) {
+            return configured;
+        }
+        return {AddressSegment{0, DeviceConfig::getModbusConfig().mapping_size}};
+    }
+
+    void close_socket(int socket_fd) {
+#ifdef _WIN32
+        closesocket(socket_fd);
+#else
+        close(socket_fd);
+#endif
+    }
+
+    /**
+     * Opens a listening TCP socket for one worker. With SO_REUSEPORT every
+     * worker binds its own socket to the same port and the kernel spreads
+     * incoming connections across them.
+     */
+    int open_listen_socket(const ModbusServerConfig& config) {
+        int listen_socket = static_cast<int>(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+        if (listen_socket == -1) {
+            throw std::runtime_error(std::string("Failed to create socket: ") + strerror(errno));
+        }
+        
+        int enable = 1;
+        setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&enable), sizeof(enable));
+#ifdef SO_REUSEPORT
+        if (setsockopt(listen_socket, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<const char*>(&enable), sizeof(enable)) == -1) {
+            close_socket(listen_socket);
+            throw std::runtime_error(std::string("Failed to set SO_REUSEPORT: ") + strerror(errno));
+        }
+#endif
+        
+        struct sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(config.port));
+        if (config.listen_address.empty() || config.listen_address == "0.0.0.0") {
+            addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        } else if (inet_pton(AF_INET, config.listen_address.c_str(), &addr.sin_addr) != 1) {
+            close_socket(listen_socket);
+            throw std::runtime_error("Invalid listen address: " + config.listen_address);
+        }
+        
+        if (bind(listen_socket, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1 ||
+            listen(listen_socket, config.max_connections > 0 ? config.max_connections : SOMAXCONN) == -1) {
+            std::string error = strerror(errno);
+            close_socket(listen_socket);
+            throw std::runtime_error("Failed to listen: " + error);
+        }
+        
+        return listen_socket;
+    }
 }
 
 // Flag to indicate if the server thread should continue running
 std::atomic<bool> server_running{true};
 
 // Add ClientConnection implementation after the namespace but before ModbusServer constructor
-ClientConnection::ClientConnection(int socket, const std::string& ip)
-    : socket_(socket), ip_(ip), 
-      creation_time_(std::chrono::system_clock::now()),
-      last_activity_(creation_time_) {
+void ClientConnection::open(int socket, uint32_t address) {
+    int64_t now = std::chrono::system_clock::now().time_since_epoch().count();
+    socket_.store(socket, std::memory_order_relaxed);
+    address_.store(address, std::memory_order_relaxed);
+    creation_time_.store(now, std::memory_order_relaxed);
+    last_activity_.store(now, std::memory_order_relaxed);
+    request_count_.store(0, std::memory_order_relaxed);
+    if (framer_) {
+        framer_->reset();
+    } else {
+        framer_ = std::make_unique<MbapFramer>();
+    }
+    if (responses_) {
+        responses_->reset();
+    } else {
+        responses_ = std::make_unique<ResponseQueue>();
+    }
+    timer_.cancel();
+    timer_.id = socket;
+    last_request_ms_ = TimerWheel::now_ms();
+    partial_since_ms_ = 0;
+    tokens_ = 0;
+    tokens_refilled_ms_ = 0;  // First request finds a full bucket
+    priority_ = 1;
+    // Publishes the fields above to statistics readers
+    is_active_.store(true, std::memory_order_release);
 }
 
-ClientConnection::~ClientConnection() {
-    // Close the socket if it's still open
-    if (socket_ >= 0 && is_active_) {
-#ifdef _WIN32
-        closesocket(socket_);
-#else
-        close(socket_);
-#endif
-        socket_ = -1;
+std::string ClientConnection::getIp() const {
+    struct in_addr addr{};
+    addr.s_addr = address_.load(std::memory_order_relaxed);
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr, ip, INET_ADDRSTRLEN);
+    return ip;
+}
+
+bool ClientConnection::takeRequestToken(uint64_t now_ms, uint64_t rate, uint64_t burst) {
+    // Tokens are kept in thousandths so rate * elapsed milliseconds refills exactly
+    uint64_t capacity = burst * 1000;
+    uint64_t elapsed = now_ms - tokens_refilled_ms_;
+    tokens_ = elapsed >= capacity ? capacity : std::min(capacity, tokens_ + elapsed * rate);
+    tokens_refilled_ms_ = now_ms;
+    
+    if (tokens_ < 1000) {
+        return false;
     }
+    tokens_ -= 1000;
+    return true;
 }
 
 void ClientConnection::updateLastActivity() {
-    last_activity_ = std::chrono::system_clock::now();
+    last_activity_.store(std::chrono::system_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
 }
 
-ModbusServer::ModbusServer() : thread_(nullptr), start_time_(std::chrono::system_clock::now()) {
+ModbusServer::ModbusServer()
+    : image_(table_layout(DeviceConfig::getModbusConfig().coils),
+             table_layout(DeviceConfig::getModbusConfig().discrete_inputs),
+             table_layout(DeviceConfig::getModbusConfig().holding_registers),
+             table_layout(DeviceConfig::getModbusConfig().input_registers),
+             DeviceConfig::getModbusConfig().fifos,
+             DeviceConfig::getModbusConfig().bit_layout == "packed" ? ProcessImage::BitLayout::Packed
+                                                                    : ProcessImage::BitLayout::Bytes),
+      start_time_(std::chrono::system_clock::now()) {
     // Get configuration
     const auto& config = DeviceConfig::getModbusConfig();
     
-    // Initialize Modbus mapping
-    mapping_ = modbus_mapping_new(
-        config.mapping_size, 
-        config.mapping_size, 
-        config.mapping_size, 
-        config.mapping_size
-    );
+    // One connection slot per possible descriptor number
+    connection_capacity_ = connection_table_size(config);
+    connections_ = std::make_unique<ClientConnection[]>(connection_capacity_);
     
-    if (!mapping_) {
-        throw std::runtime_error("Failed to allocate Modbus mapping");
+    // Resolve the [Priority] rules once; workers only read them
+    for (const auto& rule : DeviceConfig::getPriorityRules()) {
+        int weight = std::max(rule.weight, 1);
+        struct in_addr addr{};
+        if (rule.client.rfind("unit:", 0) == 0) {
+            try {
+                int unit = std::stoi(rule.client.substr(5));
+                if (unit >= 0 && unit <= 255) {
+                    unit_priorities_[unit] = weight;
+                    has_unit_priorities_ = true;
+                    continue;
+                }
+            } catch (const std::exception&) {
+                // Reported below
+            }
+        } else if (inet_pton(AF_INET, rule.client.c_str(), &addr) == 1) {
+            address_priorities_[addr.s_addr] = weight;
+            continue;
+        }
+        std::cerr << "[Modbus] Ignoring priority rule for unknown client '" << rule.client << "'" << std::endl;
     }
     
     // Initialize Lua hooks for simulation
-    ModbusHandler::init_lua_hooks(mapping_, this);
+    ModbusHandler::init_lua_hooks(image_, this);
     
     // Start the PLC logic
-    PlcLogic::start(mapping_);
+    PlcLogic::start(&image_);
     PlcLogic::loadScript("active.plc");
     
-    // Start the server in a separate thread
-    thread_ = new std::thread(&ModbusServer::run_server, this);
+    // Start the worker reactors, each with its own listening socket
+    int worker_count = std::max(1, config.workers);
+#ifndef SO_REUSEPORT
+    if (worker_count > 1) {
+        std::cerr << "[Modbus] SO_REUSEPORT is not available on this platform, using a single worker" << std::endl;
+        worker_count = 1;
+    }
+#endif
+#ifndef SIMPLEPLC_HAVE_IO_URING
+    if (config.backend == "io_uring") {
+        std::cerr << "[Modbus] io_uring backend requested but not compiled in, using the default event loop" << std::endl;
+    }
+#endif
+    for (int worker_id = 0; worker_id < worker_count; worker_id++) {
+        workers_.emplace_back(&ModbusServer::run_server, this, worker_id);
+    }
 }
 
 ModbusServer::~ModbusServer() {
     // Signal the server thread to stop
     server_running = false;
     
-    // Wait for the thread to finish
-    if (thread_ && thread_->joinable()) {
-        thread_->join();
-        delete thread_;
-        thread_ = nullptr;
-    }
-    
-    // Close all active connections
-    {
-        std::lock_guard<std::mutex> lock(connections_mutex);
-        for (auto& pair : connections_) {
-            pair.second->markInactive();
+    // Wait for all worker threads to finish
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
         }
-        connections_.clear();
     }
+    workers_.clear();
+    
+    // Close all active connections once no worker can touch them anymore
+    close_all_clients();
     
     // Print final statistics
     std::cout << "\n=== Final Modbus Server Statistics ===\n" << getStatistics() << std::endl;
     
     PlcLogic::stop();
     
-    if (mapping_) {
-        modbus_mapping_free(mapping_);
-        mapping_ = nullptr;
-    }
-    
     std::cout << "[Info] Modbus server stopped\n";
 }
 
-void ModbusServer::run_server() {
+void ModbusServer::run_server(int worker_id) {
     // Get configuration
     const auto& config = DeviceConfig::getModbusConfig();
     
-    // Variables for select() based server
-    fd_set refset;
-    fd_set rdset;
-    int max_fd = -1;
-    uint8_t query[MODBUS_TCP_MAX_ADU_LENGTH];
+    // Pin this worker to its configured CPU, round-robin over the list
+    if (!config.cpu_affinity.empty()) {
+        int cpu = config.cpu_affinity[static_cast<size_t>(worker_id) % config.cpu_affinity.size()];
+        if (!platform::pin_current_thread(cpu)) {
+            std::cerr << "[Modbus] Worker " << worker_id << " could not be pinned to CPU " << cpu << std::endl;
+        }
+    }
     
     try {
-        // Initialize the Modbus context
-        modbus_t* ctx = modbus_new_tcp(config.listen_address.c_str(), config.port);
-        if (!ctx) {
-            throw std::runtime_error(std::string("Failed to create context: ") + modbus_strerror(errno));
-        }
-
-        // Get device configuration for slave ID
-        const auto& device_info = DeviceConfig::getDeviceInfo();
-        modbus_set_slave(ctx, device_info.slave_id);
-        
-        // Create the server socket
-        int server_socket = modbus_tcp_listen(ctx, config.max_connections);
-        if (server_socket == -1) {
-            throw std::runtime_error(std::string("Failed to listen: ") + modbus_strerror(errno));
-        }
+        // Create this worker's server socket; the kernel balances new connections across workers
+        int server_socket = open_listen_socket(config);
         
-        std::cout << "[Modbus] Server listening on " << config.listen_address 
+        std::cout << "[Modbus] Worker " << worker_id << " listening on " << config.listen_address 
                   << ":" << config.port << " (max connections: " << config.max_connections << ")" << std::endl;
         
-        // Initialize the reference set for select()
-        FD_ZERO(&refset);
-        FD_SET(server_socket, &refset);
-        max_fd = server_socket;
+        // Only the first worker reports periodic statistics
+        bool report_stats = worker_id == 0;
+        bool served = false;
+#ifdef SIMPLEPLC_HAVE_IO_URING
+        if (config.backend == "io_uring") {
+            // Falls back to epoll if the kernel refuses the ring setup
+            served = run_uring_loop(server_socket, report_stats);
+        }
+#endif
+        if (!served) {
+#ifdef __linux__
+            run_epoll_loop(server_socket, report_stats);
+#else
+            run_select_loop(server_socket, report_stats);
+#endif
+        }
+        
+        // Worker is shutting down; client sockets are closed once all workers have stopped
+        std::cout << "[Modbus] Worker " << worker_id << " closing server socket..." << std::endl;
+        close_socket(server_socket);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[Modbus] Error in worker " << worker_id << ": " << e.what() << std::endl;
+    }
+    
+    std::cout << "[Modbus] Worker " << worker_id << " exiting" << std::endl;
+}
+
+#ifdef __linux__
+void ModbusServer::run_epoll_loop(int server_socket, bool report_stats) {
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        throw std::runtime_error(std::string("Failed to create epoll instance: ") + strerror(errno));
+    }
+    
+    // The listener is edge-triggered as well, so it must never block in accept()
+    int flags = fcntl(server_socket, F_GETFL, 0);
+    if (flags == -1 || fcntl(server_socket, F_SETFL, flags | O_NONBLOCK) == -1) {
+        close(epoll_fd);
+        throw std::runtime_error(std::string("Failed to make server socket non-blocking: ") + strerror(errno));
+    }
+    
+    struct epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = server_socket;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_socket, &ev) == -1) {
+        close(epoll_fd);
+        throw std::runtime_error(std::string("Failed to register server socket: ") + strerror(errno));
+    }
+    
+    auto last_stats_time = std::chrono::steady_clock::now();
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    TimerWheel reaper(TimerWheel::now_ms());
+    FairScheduler scheduler(connection_capacity_, DeviceConfig::getModbusConfig().fair_quantum);
+    
+    // Main server loop - blocks in epoll_wait() only, no polling delay
+    while (server_running) {
+        // Short timeout to allow checking server_running flag; don't block while clients have work left
+        int ready = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, scheduler.idle() ? EVENT_LOOP_TIMEOUT_MS : 0);
         
-        // Setup for periodic maintenance and statistics
-        auto last_stats_time = std::chrono::steady_clock::now();
-        const auto stats_interval = std::chrono::minutes(1);
+        if (ready == -1) {
+            if (errno != EINTR) {
+                std::cerr << "[Modbus] epoll_wait error: " << strerror(errno) << std::endl;
+            }
+            continue;
+        }
         
-        // Main server loop
-        while (server_running) {
-            // Copy the reference set to the working set
-            rdset = refset;
+        for (int i = 0; i < ready; i++) {
+            int socket_fd = events[i].data.fd;
             
-            // Setup timeout for select - short to allow checking server_running flag
-            struct timeval timeout;
-            timeout.tv_sec = 0;
-            timeout.tv_usec = 100000; // 100ms for responsive checking of server_running flag
+            if (socket_fd == server_socket) {
+                // Edge-triggered: drain the accept queue completely
+                int client_socket;
+                while (accept_client(server_socket, client_socket)) {
+                    if (client_socket == -1) {
+                        continue;
+                    }
+                    
+                    struct epoll_event client_ev{};
+                    // EPOLLOUT resumes a connection whose responses did not fit into the socket buffer
+                    client_ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                    client_ev.data.fd = client_socket;
+                    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_socket, &client_ev) == -1) {
+                        std::cerr << "[Modbus] Failed to register client socket " << client_socket
+                                  << ": " << strerror(errno) << std::endl;
+                        close_client(client_socket);
+                        continue;
+                    }
+                    arm_reaper(reaper, client_socket);
+                }
+                continue;
+            }
             
-            // Wait for activity on any socket
-            int result = select(max_fd + 1, &rdset, NULL, NULL, &timeout);
+            ClientConnection* connection = getConnection(socket_fd);
+            if (!connection) {
+                continue;
+            }
             
-            if (result == -1) {
-                if (errno != EINTR) {
-#ifdef _WIN32
-                    std::cerr << "[Modbus] Select error: " << WSAGetLastError() << std::endl;
-#else
-                    std::cerr << "[Modbus] Select error: " << strerror(errno) << std::endl;
-#endif
-                }
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                // Closing the descriptor also removes it from the epoll set
+                scheduler.remove(socket_fd);
+                close_client(socket_fd);
                 continue;
             }
             
-            // Check for timeout
-            if (result == 0) {
-                // Periodic statistics
-                auto now = std::chrono::steady_clock::now();
-                if (now - last_stats_time > stats_interval) {
-                    std::cout << "\n=== Modbus Server Statistics ===\n" << getStatistics() << std::endl;
-                    last_stats_time = now;
-                }
+            // A bare writability edge only matters while responses are backed up
+            if ((events[i].events & (EPOLLIN | EPOLLRDHUP)) == 0 && connection->getResponses().empty()) {
                 continue;
             }
             
-            // Check each socket for activity
-            for (int socket_fd = 0; socket_fd <= max_fd; socket_fd++) {
-                if (!FD_ISSET(socket_fd, &rdset)) {
-                    continue;
-                }
-                
-                // If the listening socket is active, accept a new connection
-                if (socket_fd == server_socket) {
-                    struct sockaddr_in client_addr;
-                    socklen_t addrlen = sizeof(client_addr);
-                    int client_socket = accept(server_socket, reinterpret_cast<struct sockaddr*>(&client_addr), &addrlen);
-                    
-                    if (client_socket == -1) {
-#ifdef _WIN32
-                        std::cerr << "[Modbus] Accept error: " << WSAGetLastError() << std::endl;
-#else
-                        std::cerr << "[Modbus] Accept error: " << strerror(errno) << std::endl;
-#endif
-                        continue;
-                    }
-                    
-                    // Get client IP address for logging
-                    char client_ip[INET_ADDRSTRLEN];
-                    inet_ntop(AF_INET, &(client_addr.sin_addr), client_ip, INET_ADDRSTRLEN);
-                    std::string client_ip_str(client_ip);
-                    
-                    std::cout << "[Modbus] New client connection accepted from " << client_ip_str
-                              << " on socket " << client_socket << std::endl;
-                    
-                    // Configure client socket
-                    if (!configure_client_socket(client_socket)) {
-                        std::cerr << "[Modbus] Failed to configure client socket " << client_socket << std::endl;
-#ifdef _WIN32
-                        closesocket(client_socket);
-#else
-                        close(client_socket);
-#endif
-                        continue;
-                    }
-                    
-                    // Add the socket to the reference set
-                    FD_SET(client_socket, &refset);
-                    
-                    // Update the maximum file descriptor if needed
-                    if (client_socket > max_fd) {
-                        max_fd = client_socket;
-                    }
-                    
-                    // Track this connection
-                    addConnection(client_socket, client_ip_str);
-                    
-                    std::cout << "[Modbus] Active connections: " << getActiveConnectionCount() << std::endl;
-                } else {
-                    // This is a client socket with data to read
-                    auto connection = getConnection(socket_fd);
-                    if (connection) {
-                        connection->updateLastActivity();
-                    }
-                    
-                    // Set the socket in the context
-                    modbus_set_socket(ctx, socket_fd);
-                    
-                    // Process the client request
-                    int rc = modbus_receive(ctx, query);
-                    
-                    if (rc > 0) {
-                        // Successfully received data
-                        if (connection) {
-                            connection->incrementRequestCount();
-                            total_requests_++;
-                        }
-                        
-                        uint8_t func = query[7];
-                        //std::cout << "[Modbus] Received function 0x" 
-                        //         << std::hex << static_cast<int>(func) << std::dec 
-                        //         << " (length: " << rc << " bytes)"
-                        //         << (connection ? " from " + connection->getIp() : "") 
-                        //         << std::endl;
-                        
-                        try {
-                            // Lock the mapping for thread safety during reply
-                            std::lock_guard<std::mutex> lock(mapping_mutex);
-                            
-                            // Handle different function codes
-                            if (func == 0x11) {
-                                ModbusHandler::send_report_slave_id(socket_fd, ctx, query, rc);
-                            }
-                            else if (func == 0x2B) {
-                                ModbusHandler::send_read_device_id(socket_fd, ctx, query, rc);
-                            }
-                            else {
-                                // Process any write operations
-                                ModbusHandler::handle_standard_function(ctx, query, rc, mapping_);
-                                
-                                // Send the reply
-                                if (modbus_reply(ctx, query, rc, mapping_) == -1) {
-                                    std::cerr << "[Modbus] Error in modbus_reply: " 
-                                             << modbus_strerror(errno) << std::endl;
-                                } else {
-                                    //std::cout << "[Modbus] Successfully sent reply for function 0x" 
-                                    //         << std::hex << static_cast<int>(func) << std::dec << std::endl;
-                                }
-                            }
-                        } catch (const std::exception& e) {
-                            std::cerr << "[Modbus] Error processing request: " << e.what() << std::endl;
-                        }
-                    } else if (rc == -1) {
-                        // Error receiving data
-#ifdef _WIN32
-                        if (WSAGetLastError() != WSAEWOULDBLOCK && WSAGetLastError() != WSAETIMEDOUT) {
-#else
-                        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ETIMEDOUT) {
+            scheduler.activate(socket_fd, connection->getPriority());
+        }
+        
+        // Edge-triggered: a connection is served until its socket would block, its responses
+        // back up, or its share of the round is used up, in which case it stays ready
+        scheduler.run_round([&](int socket_fd, int& budget) {
+            FairScheduler::Outcome outcome = handle_client_readable(socket_fd, budget);
+            if (outcome == FairScheduler::Outcome::Closed) {
+                close_client(socket_fd);
+            }
+            return outcome;
+        });
+        
+        // Evict idle and stalled clients
+        uint64_t now_ms = TimerWheel::now_ms();
+        reaper.advance(now_ms);
+        for (int expired; (expired = next_expired_client(reaper, now_ms)) != -1;) {
+            scheduler.remove(expired);
+            close_client(expired);
+        }
+        
+        if (report_stats) {
+            print_periodic_statistics(last_stats_time);
+        }
+    }
+    
+    close(epoll_fd);
+}
 #endif
-                            // Real error, not timeout - close the connection
-                            std::cout << "[Modbus] Connection closed on socket " << socket_fd 
-                                     << (connection ? " from " + connection->getIp() : "") << std::endl;
-                            
-                            // Close the socket
+
+void ModbusServer::run_select_loop(int server_socket, bool report_stats) {
+    // Variables for select() based server
+    fd_set refset;
+    fd_set rdset;
+    fd_set write_refset;  // Clients waiting to flush responses; not read until they have
+    fd_set wrset;
+    int max_fd = server_socket;
+    
+    // Initialize the reference sets for select()
+    FD_ZERO(&refset);
+    FD_ZERO(&write_refset);
+    FD_SET(server_socket, &refset);
+    
+    auto last_stats_time = std::chrono::steady_clock::now();
+    TimerWheel reaper(TimerWheel::now_ms());
+    FairScheduler scheduler(connection_capacity_, DeviceConfig::getModbusConfig().fair_quantum);
+    
+    auto drop_client = [&](int socket_fd) {
+        scheduler.remove(socket_fd);
+        close_client(socket_fd);
+        
+        // Remove from reference sets
+        FD_CLR(socket_fd, &refset);
+        FD_CLR(socket_fd, &write_refset);
+        
+        // Update max_fd if necessary
+        if (socket_fd == max_fd) {
+            // Find the new max_fd
+            max_fd = server_socket;
+            for (int i = 0; i <= socket_fd; i++) {
+                if ((FD_ISSET(i, &refset) || FD_ISSET(i, &write_refset)) && i > max_fd) {
+                    max_fd = i;
+                }
+            }
+        }
+    };
+    
+    // Main server loop
+    while (server_running) {
+        // Copy the reference sets to the working sets
+        rdset = refset;
+        wrset = write_refset;
+        
+        // Setup timeout for select - short to allow checking server_running flag,
+        // zero while clients have work left over from the previous round
+        struct timeval timeout;
+        timeout.tv_sec = 0;
+        timeout.tv_usec = scheduler.idle() ? EVENT_LOOP_TIMEOUT_MS * 1000 : 0;
+        
+        // Wait for activity on any socket
+        int result = select(max_fd + 1, &rdset, &wrset, NULL, &timeout);
+        
+        if (result == -1) {
+            if (errno != EINTR) {
 #ifdef _WIN32
-                            closesocket(socket_fd);
+                std::cerr << "[Modbus] Select error: " << WSAGetLastError() << std::endl;
 #else
-                            close(socket_fd);
+                std::cerr << "[Modbus] Select error: " << strerror(errno) << std::endl;
 #endif
-                            
-                            // Remove from reference set
-                            FD_CLR(socket_fd, &refset);
-                            
-                            // Remove from connection tracking
-                            removeConnection(socket_fd);
-                            
-                            // Update max_fd if necessary
-                            if (socket_fd == max_fd) {
-                                // Find the new max_fd
-                                max_fd = server_socket;
-                                for (int i = 0; i <= socket_fd; i++) {
-                                    if (FD_ISSET(i, &refset) && i > max_fd) {
-                                        max_fd = i;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
+            }
+            continue;
+        }
+        
+        // Check each socket for activity
+        for (int socket_fd = 0; result > 0 && socket_fd <= max_fd; socket_fd++) {
+            if (!FD_ISSET(socket_fd, &rdset) && !FD_ISSET(socket_fd, &wrset)) {
+                continue;
             }
             
-            // Small delay to prevent CPU spinning
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            // If the listening socket is active, accept a new connection
+            if (socket_fd == server_socket) {
+                int client_socket;
+                if (!accept_client(server_socket, client_socket) || client_socket == -1) {
+                    continue;
+                }
+                
+                // Add the socket to the reference set
+                FD_SET(client_socket, &refset);
+                
+                // Update the maximum file descriptor if needed
+                if (client_socket > max_fd) {
+                    max_fd = client_socket;
+                }
+                arm_reaper(reaper, client_socket);
+            } else if (ClientConnection* connection = getConnection(socket_fd)) {
+                scheduler.activate(socket_fd, connection->getPriority());
+            }
         }
         
-        // Server is shutting down, close all sockets
-        std::cout << "[Modbus] Closing server socket and all client connections..." << std::endl;
+        scheduler.run_round([&](int socket_fd, int& budget) {
+            FairScheduler::Outcome outcome = handle_client_readable(socket_fd, budget);
+            if (outcome == FairScheduler::Outcome::Closed) {
+                drop_client(socket_fd);
+                return outcome;
+            }
+            
+            // Wait for writability instead of readability while responses are backed up
+            ClientConnection* connection = getConnection(socket_fd);
+            if (connection && !connection->getResponses().empty()) {
+                FD_CLR(socket_fd, &refset);
+                FD_SET(socket_fd, &write_refset);
+            } else if (connection) {
+                FD_CLR(socket_fd, &write_refset);
+                FD_SET(socket_fd, &refset);
+            }
+            return outcome;
+        });
         
-        // Close the server socket
-        #ifdef _WIN32
-        closesocket(server_socket);
-        #else
-        close(server_socket);
-        #endif
+        // Evict idle and stalled clients
+        uint64_t now_ms = TimerWheel::now_ms();
+        reaper.advance(now_ms);
+        for (int expired; (expired = next_expired_client(reaper, now_ms)) != -1;) {
+            drop_client(expired);
+        }
         
-        // Close all client sockets
-        for (int socket_fd = 0; socket_fd <= max_fd; socket_fd++) {
-            if (FD_ISSET(socket_fd, &refset) && socket_fd != server_socket) {
+        if (report_stats) {
+            print_periodic_statistics(last_stats_time);
+        }
+    }
+}
+
+bool ModbusServer::accept_client(int server_socket, int& client_socket) {
+    struct sockaddr_in client_addr;
+    socklen_t addrlen = sizeof(client_addr);
+    client_socket = accept(server_socket, reinterpret_cast<struct sockaddr*>(&client_addr), &addrlen);
+    
+    if (client_socket == -1) {
 #ifdef _WIN32
-                closesocket(socket_fd);
+        std::cerr << "[Modbus] Accept error: " << WSAGetLastError() << std::endl;
 #else
-                close(socket_fd);
+        // A non-blocking listener reports an empty accept queue this way
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            std::cerr << "[Modbus] Accept error: " << strerror(errno) << std::endl;
+        }
 #endif
-            }
+        return false;
+    }
+    
+    if (!admit_client(client_socket, client_addr)) {
+        client_socket = -1;
+    }
+    return true;
+}
+
+bool ModbusServer::admit_client(int client_socket, const struct sockaddr_in& client_addr) {
+    // Get client IP address for logging
+    char client_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &(client_addr.sin_addr), client_ip, INET_ADDRSTRLEN);
+    
+    std::cout << "[Modbus] New client connection accepted from " << client_ip
+              << " on socket " << client_socket << std::endl;
+    
+    // Configure client socket
+    if (!configure_client_socket(client_socket)) {
+        std::cerr << "[Modbus] Failed to configure client socket " << client_socket << std::endl;
+        close_socket(client_socket);
+        return false;
+    }
+    
+    // Enforce the global and per-IP connection limits
+    uint32_t address = client_addr.sin_addr.s_addr;
+    if (!reserve_admission(address)) {
+        std::cerr << "[Modbus] Connection limit reached, refusing client " << client_ip
+                  << " on socket " << client_socket << std::endl;
+        rejected_connections_.fetch_add(1, std::memory_order_relaxed);
+        close_socket(client_socket);
+        return false;
+    }
+    
+    // Track this connection
+    ClientConnection* connection = addConnection(client_socket, address);
+    if (!connection) {
+        std::cerr << "[Modbus] Socket " << client_socket << " exceeds the connection table ("
+                  << connection_capacity_ << " slots), rejecting client" << std::endl;
+        release_admission(address);
+        rejected_connections_.fetch_add(1, std::memory_order_relaxed);
+        close_socket(client_socket);
+        return false;
+    }
+    connection->setPriority(priority_for_address(address));
+    
+    std::cout << "[Modbus] Active connections: " << getActiveConnectionCount() << std::endl;
+    return true;
+}
+
+FairScheduler::Outcome ModbusServer::handle_client_readable(int socket_fd, int& budget) {
+    ClientConnection* connection = getConnection(socket_fd);
+    if (!connection) {
+        // Closed while it was waiting on the ready list
+        return FairScheduler::Outcome::Drained;
+    }
+    
+    MbapFramer& framer = connection->getFramer();
+    ResponseQueue& responses = connection->getResponses();
+    
+    // Alternate between answering buffered requests and reading more until the socket
+    // would block or this connection's share of the round is used up
+    for (;;) {
+        if (!dispatch_frames(socket_fd, *connection, budget)) {
+            return FairScheduler::Outcome::Closed;
+        }
+        
+        switch (responses.flush(socket_fd)) {
+            case ResponseQueue::FlushResult::Done:
+                break;
+            case ResponseQueue::FlushResult::Pending:
+                // Stop reading until the client drains its receive window; writability reactivates it
+                return FairScheduler::Outcome::Drained;
+            case ResponseQueue::FlushResult::Error:
+                std::cout << "[Modbus] Send failed on socket " << socket_fd 
+                         << " from " << connection->getIp() << std::endl;
+                return FairScheduler::Outcome::Closed;
+        }
+        
+        if (budget <= 0) {
+            // Unread requests or socket data are picked up next round
+            return FairScheduler::Outcome::Backlogged;
+        }
+        
+        // Requests left over because the response queue filled up
+        if (framer.has_frame()) {
+            continue;
         }
         
-        // Free the context
-        modbus_free(ctx);
+        switch (framer.receive(socket_fd)) {
+            case MbapFramer::ReceiveResult::Data:
+                connection->updateLastActivity();
+                break;
+            case MbapFramer::ReceiveResult::WouldBlock:
+                // Any partial frame stays buffered until more bytes arrive, within frame_timeout_ms
+                if (framer.pending() > 0) {
+                    connection->markPartialFrame(TimerWheel::now_ms());
+                }
+                return FairScheduler::Outcome::Drained;
+            case MbapFramer::ReceiveResult::Closed:
+            case MbapFramer::ReceiveResult::Error:
+                std::cout << "[Modbus] Connection closed on socket " << socket_fd 
+                         << " from " << connection->getIp() << std::endl;
+                return FairScheduler::Outcome::Closed;
+        }
     }
-    catch (const std::exception& e) {
-        std::cerr << "[Modbus] Error in server thread: " << e.what() << std::endl;
+}
+
+bool ModbusServer::dispatch_frames(int socket_fd, ClientConnection& connection, int& budget) {
+    MbapFramer& framer = connection.getFramer();
+    ResponseQueue& responses = connection.getResponses();
+    
+    const auto& config = DeviceConfig::getModbusConfig();
+    uint64_t rate = static_cast<uint64_t>(std::max(config.request_rate, 0));
+    uint64_t burst = config.request_burst > 0 ? static_cast<uint64_t>(config.request_burst) : std::max<uint64_t>(rate, 1);
+    uint64_t now_ms = TimerWheel::now_ms();
+    bool received = false;
+    
+    const uint8_t* query;
+    int rc;
+    while (budget > 0 && !responses.full() && framer.next_frame(query, rc)) {
+        received = true;
+        budget--;
+        if (connection.getPriority() == 0) {
+            // No address rule matched; the unit ID of the first request decides
+            int weight = unit_priorities_[query[6]];
+            connection.setPriority(weight > 0 ? weight : 1);
+        }
+        if (rate > 0 && !connection.takeRequestToken(now_ms, rate, burst)) {
+            // Over its rate limit: answer "server busy" without touching the image
+            uint8_t* response = responses.reserve();
+            responses.commit(static_cast<size_t>(ModbusHandler::build_exception_response(
+                query, MODBUS_EXCEPTION_SLAVE_OR_SERVER_BUSY, response)));
+            throttled_requests_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        
+        connection.incrementRequestCount();
+        total_requests_.fetch_add(1, std::memory_order_relaxed);
+        process_request(responses, query, rc);
+    }
+    
+    if (received) {
+        connection.markRequest(now_ms);
     }
     
-    std::cout << "[Modbus] Server thread exiting" << std::endl;
+    if (framer.malformed()) {
+        std::cerr << "[Modbus] Malformed MBAP header on socket " << socket_fd 
+                  << " from " << connection.getIp() << ", closing connection" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ModbusServer::process_request(ResponseQueue& responses, const uint8_t* query, int rc) {
+    uint8_t func = query[7];
+    //std::cout << "[Modbus] Received function 0x" 
+    //         << std::hex << static_cast<int>(func) << std::dec 
+    //         << " (length: " << rc << " bytes)" << std::endl;
+    
+    // Reserved up front: every request gets exactly one response, in its place in the queue
+    uint8_t* response = responses.reserve();
+    int length = 0;
+    try {
+        // Handle different function codes
+        if (func == MODBUS_FC_REPORT_SLAVE_ID) {
+            length = ModbusHandler::build_report_slave_id(query, rc, response);
+        }
+        else if (func == 0x2B) {
+            length = ModbusHandler::build_read_device_id(query, rc, response);
+        }
+        else if (ModbusHandler::encodes_natively(func)) {
+            // Validated, applied once and answered in a single pass
+            length = ModbusHandler::build_standard_response(query, rc, image_, response, &response_cache_);
+        }
+        else {
+            // Every function code modbus_reply() would answer from the image is encoded natively;
+            // for the rest it only ever sent Illegal Function, so that is answered here without
+            // touching the image
+            length = ModbusHandler::build_exception_response(query, MODBUS_EXCEPTION_ILLEGAL_FUNCTION, response);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[Modbus] Error processing request: " << e.what() << std::endl;
+        length = 0;
+    }
+    
+    // A failed request is still answered, so the client is not left waiting and the
+    // responses pipelined behind it keep their order
+    if (length <= 0) {
+        length = ModbusHandler::build_exception_response(query, MODBUS_EXCEPTION_SLAVE_OR_SERVER_FAILURE, response);
+    }
+    responses.commit(static_cast<size_t>(length));
+}
+
+void ModbusServer::arm_reaper(TimerWheel& reaper, int socket_fd) {
+    ClientConnection* connection = getConnection(socket_fd);
+    if (!connection) {
+        return;
+    }
+    uint64_t deadline = reaper_deadline(*connection, TimerWheel::now_ms());
+    if (deadline != 0) {
+        reaper.schedule(connection->getTimer(), deadline);
+    }
+}
+
+int ModbusServer::next_expired_client(TimerWheel& reaper, uint64_t now_ms) {
+    const auto& config = DeviceConfig::getModbusConfig();
+    
+    while (TimerWheel::Timer* timer = reaper.pop_expired()) {
+        ClientConnection* connection = getConnection(timer->id);
+        if (!connection) {
+            continue;
+        }
+        
+        uint64_t partial_since = connection->getPartialFrameTime();
+        if (config.frame_timeout_ms > 0 && partial_since != 0 &&
+            now_ms >= partial_since + static_cast<uint64_t>(config.frame_timeout_ms)) {
+            std::cout << "[Modbus] Closing connection on socket " << timer->id << " from " << connection->getIp()
+                      << ": incomplete request for more than " << config.frame_timeout_ms << " ms" << std::endl;
+            return timer->id;
+        }
+        if (config.idle_timeout_ms > 0 &&
+            now_ms >= connection->getLastRequestTime() + static_cast<uint64_t>(config.idle_timeout_ms)) {
+            std::cout << "[Modbus] Closing connection on socket " << timer->id << " from " << connection->getIp()
+                      << ": idle for more than " << config.idle_timeout_ms << " ms" << std::endl;
+            return timer->id;
+        }
+        
+        // The client made progress since the timer was armed
+        uint64_t deadline = reaper_deadline(*connection, now_ms);
+        if (deadline != 0) {
+            reaper.schedule(*timer, deadline);
+        }
+    }
+    return -1;
+}
+
+void ModbusServer::close_client(int socket_fd) {
+    // Stop tracking first: once the descriptor is closed, another worker may accept a
+    // connection on the same number and open this slot for it
+    removeConnection(socket_fd);
+    
+    close_socket(socket_fd);
+}
+
+void ModbusServer::close_all_clients() {
+    for (size_t socket_fd = 0; socket_fd < connection_capacity_; socket_fd++) {
+        if (connections_[socket_fd].isActive()) {
+            close_client(static_cast<int>(socket_fd));
+        }
+    }
+}
+
+void ModbusServer::print_periodic_statistics(std::chrono::steady_clock::time_point& last_stats_time) {
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_stats_time > STATS_INTERVAL) {
+        std::cout << "\n=== Modbus Server Statistics ===\n" << getStatistics() << std::endl;
+        last_stats_time = now;
+    }
 }
 
 bool ModbusServer::configure_client_socket(int client_socket) {
-    // Make socket blocking for synchronous I/O
+    // Make socket non-blocking; partial frames are buffered per connection
 #ifdef _WIN32
-    unsigned long mode = 0;  // 0 = blocking, 1 = non-blocking
+    unsigned long mode = 1;  // 0 = blocking, 1 = non-blocking
     if (ioctlsocket(client_socket, FIONBIO, &mode) != 0) {
-        std::cerr << "[Modbus] Error setting socket to blocking mode: " << WSAGetLastError() << std::endl;
+        std::cerr << "[Modbus] Error setting socket to non-blocking mode: " << WSAGetLastError() << std::endl;
         return false;
     }
 #else
@@ -388,8 +860,8 @@ bool ModbusServer::configure_client_socket(int client_socket) {
         return false;
     }
     
-    if (fcntl(client_socket, F_SETFL, flags & ~O_NONBLOCK) == -1) {
-        std::cerr << "[Modbus] Error setting socket to blocking mode: " << strerror(errno) << std::endl;
+    if (fcntl(client_socket, F_SETFL, flags | O_NONBLOCK) == -1) {
+        std::cerr << "[Modbus] Error setting socket to non-blocking mode: " << strerror(errno) << std::endl;
         return false;
     }
 #endif
@@ -420,33 +892,6 @@ bool ModbusServer::configure_client_socket(int client_socket) {
         // Non-critical, continue anyway
     }
     
-    // Set receive and send timeouts
-    struct timeval timeout;
-    timeout.tv_sec = DEFAULT_CLIENT_TIMEOUT_SEC;
-    timeout.tv_usec = DEFAULT_CLIENT_TIMEOUT_USEC;
-    
-    if (setsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout)) < 0) {
-        std::cerr << "[Modbus] Error setting socket receive timeout: " 
-#ifdef _WIN32
-                  << WSAGetLastError() 
-#else
-                  << strerror(errno) 
-#endif
-                  << std::endl;
-        return false;
-    }
-    
-    if (setsockopt(client_socket, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout)) < 0) {
-        std::cerr << "[Modbus] Error setting socket send timeout: " 
-#ifdef _WIN32
-                  << WSAGetLastError() 
-#else
-                  << strerror(errno) 
-#endif
-                  << std::endl;
-        return false;
-    }
-    
     // Set keepalive to detect dead connections
     int keepalive = 1;
     if (setsockopt(client_socket, SOL_SOCKET, SO_KEEPALIVE, reinterpret_cast<const char*>(&keepalive), sizeof(int)) < 0) {
@@ -472,54 +917,82 @@ int ModbusServer::run() {
     return 0;
 }
 
-modbus_mapping_t* ModbusServer::get_mapping() {
-    return mapping_;
-}
-
-void ModbusServer::lock_mapping() {
-    mapping_mutex.lock();
-}
-
-void ModbusServer::unlock_mapping() {
-    mapping_mutex.unlock();
+ProcessImage& ModbusServer::get_image() {
+    return image_;
 }
 
 // Add these methods to ModbusServer implementation (between existing methods)
 
-std::shared_ptr<ClientConnection> ModbusServer::addConnection(int socket, const std::string& ip) {
-    std::lock_guard<std::mutex> lock(connections_mutex);
-    auto connection = std::make_shared<ClientConnection>(socket, ip);
-    connections_[socket] = connection;
-    total_connections_++;
+ClientConnection* ModbusServer::addConnection(int socket, uint32_t address) {
+    if (socket < 0 || static_cast<size_t>(socket) >= connection_capacity_) {
+        return nullptr;
+    }
+    ClientConnection* connection = &connections_[static_cast<size_t>(socket)];
+    connection->open(socket, address);
+    active_connections_.fetch_add(1, std::memory_order_relaxed);
+    total_connections_.fetch_add(1, std::memory_order_relaxed);
     return connection;
 }
 
 void ModbusServer::removeConnection(int socket) {
-    std::lock_guard<std::mutex> lock(connections_mutex);
-    auto it = connections_.find(socket);
-    if (it != connections_.end()) {
-        it->second->markInactive();
-        connections_.erase(it);
+    ClientConnection* connection = getConnection(socket);
+    if (connection) {
+        connection->getTimer().cancel();
+        connection->markInactive();
+        active_connections_.fetch_sub(1, std::memory_order_relaxed);
+        release_admission(connection->getAddress());
     }
 }
 
-std::shared_ptr<ClientConnection> ModbusServer::getConnection(int socket) {
-    std::lock_guard<std::mutex> lock(connections_mutex);
-    auto it = connections_.find(socket);
-    if (it != connections_.end()) {
+int ModbusServer::priority_for_address(uint32_t address) const {
+    auto it = address_priorities_.find(address);
+    if (it != address_priorities_.end()) {
         return it->second;
     }
-    return nullptr;
+    return has_unit_priorities_ ? 0 : 1;
+}
+
+bool ModbusServer::reserve_admission(uint32_t address) {
+    const auto& config = DeviceConfig::getModbusConfig();
+    std::lock_guard<std::mutex> lock(admission_mutex_);
+    
+    if (config.max_connections > 0 && admitted_ >= static_cast<size_t>(config.max_connections)) {
+        return false;
+    }
+    int& per_ip = admitted_per_ip_[address];
+    if (config.max_connections_per_ip > 0 && per_ip >= config.max_connections_per_ip) {
+        return false;
+    }
+    per_ip++;
+    admitted_++;
+    return true;
+}
+
+void ModbusServer::release_admission(uint32_t address) {
+    std::lock_guard<std::mutex> lock(admission_mutex_);
+    auto it = admitted_per_ip_.find(address);
+    if (it == admitted_per_ip_.end()) {
+        return;
+    }
+    if (--it->second <= 0) {
+        admitted_per_ip_.erase(it);
+    }
+    admitted_--;
+}
+
+ClientConnection* ModbusServer::getConnection(int socket) {
+    if (socket < 0 || static_cast<size_t>(socket) >= connection_capacity_) {
+        return nullptr;
+    }
+    ClientConnection* connection = &connections_[static_cast<size_t>(socket)];
+    return connection->isActive() ? connection : nullptr;
 }
 
 size_t ModbusServer::getActiveConnectionCount() {
-    std::lock_guard<std::mutex> lock(connections_mutex);
-    return connections_.size();
+    return active_connections_.load(std::memory_order_relaxed);
 }
 
 std::string ModbusServer::getStatistics() {
-    std::lock_guard<std::mutex> lock(connections_mutex);
-    
     auto now = std::chrono::system_clock::now();
     auto uptime = std::chrono::duration_cast<std::chrono::seconds>(now - start_time_).count();
     
@@ -527,39 +1000,35 @@ std::string ModbusServer::getStatistics() {
     oss << "Server Statistics:" << std::endl;
     oss << "  Uptime: " << uptime << " seconds" << std::endl;
     oss << "  Total connections: " << total_connections_ << std::endl;
-    oss << "  Active connections: " << connections_.size() << std::endl;
+    oss << "  Active connections: " << getActiveConnectionCount() << std::endl;
     oss << "  Total requests: " << total_requests_ << std::endl;
+    oss << "  Throttled requests: " << throttled_requests_ << std::endl;
+    oss << "  Read cache: " << response_cache_.hits() << " hits, " << response_cache_.misses() << " misses" << std::endl;
+    oss << "  Rejected connections: " << rejected_connections_ << std::endl;
+    oss << std::endl << PlcLogic::getStatistics();
     
-    if (!connections_.empty()) {
-        oss << std::endl << "Active Connections:" << std::endl;
-        oss << "  Socket | IP Address      | Duration (s) | Requests" << std::endl;
-        oss << "  -------+----------------+-------------+---------" << std::endl;
-        
-        for (const auto& pair : connections_) {
-            const auto& conn = pair.second;
-            auto duration = std::chrono::duration_cast<std::chrono::seconds>(
-                now - conn->getCreationTime()).count();
-            
-            oss << "  " << std::setw(6) << conn->getSocket() << " | "
-                << std::setw(14) << conn->getIp() << " | "
-                << std::setw(11) << duration << " | "
-                << std::setw(8) << conn->getRequestCount() << std::endl;
+    // Workers keep running while this is printed, so the table is a relaxed snapshot
+    bool header = false;
+    for (size_t socket_fd = 0; socket_fd < connection_capacity_; socket_fd++) {
+        const ClientConnection& conn = connections_[socket_fd];
+        if (!conn.isActive()) {
+            continue;
+        }
+        if (!header) {
+            oss << std::endl << "Active Connections:" << std::endl;
+            oss << "  Socket | IP Address      | Duration (s) | Requests" << std::endl;
+            oss << "  -------+----------------+-------------+---------" << std::endl;
+            header = true;
         }
+        
+        auto duration = std::chrono::duration_cast<std::chrono::seconds>(
+            now - conn.getCreationTime()).count();
+        
+        oss << "  " << std::setw(6) << conn.getSocket() << " | "
+            << std::setw(14) << conn.getIp() << " | "
+            << std::setw(11) << duration << " | "
+            << std::setw(8) << conn.getRequestCount() << std::endl;
     }
     
     return oss.str();
 }
-
-void ModbusServer::cleanup_inactive_connections() {
-    std::lock_guard<std::mutex> lock(connections_mutex);
-    
-    // Remove connections that are marked as inactive
-    auto it = connections_.begin();
-    while (it != connections_.end()) {
-        if (!it->second->isActive()) {
-            it = connections_.erase(it);
-        } else {
-            ++it;
-        }
-    }
-}
\ No newline at end of file
@@ -3,58 +3,79 @@
 #include <thread>
 #include <vector>
 #include <mutex>
-#include <map>
 #include <string>
+#include <unordered_map>
 #include <atomic>
 #include <chrono>
 #include <memory>
+#include "mbap_framer.h"
+#include "response_queue.h"
+#include "response_cache.h"
+#include "timer_wheel.h"
+#include "fair_scheduler.h"
+#include "process_image.h"
+
+struct sockaddr_in;
 
 /**
  * @class ClientConnection
- * @brief Represents a client connection to the Modbus server
+ * @brief One slot of the server's connection table
+ * 
+ * Slots are pre-allocated and indexed by socket descriptor, so the request
+ * path finds its connection without a lookup or a lock. The receive and
+ * response buffers are only allocated when a descriptor first carries a
+ * connection and are then kept for its next one. A slot is only ever
+ * used by the worker that accepted the socket; the fields other threads read
+ * for statistics are atomics.
  */
 class ClientConnection {
 public:
     /**
-     * @brief Constructor for a new client connection
+     * @brief Start using this slot for a freshly accepted client
      * 
      * @param socket Socket file descriptor
-     * @param ip Client IP address
+     * @param address Client IPv4 address in network byte order
      */
-    ClientConnection(int socket, const std::string& ip);
+    void open(int socket, uint32_t address);
     
     /**
-     * @brief Destructor - closes the socket if still open
+     * @brief Get the socket file descriptor
+     * 
+     * @return Socket file descriptor
      */
-    ~ClientConnection();
+    int getSocket() const { return socket_.load(std::memory_order_relaxed); }
     
     /**
-     * @brief Get the socket file descriptor
+     * @brief Get the client IP address
      * 
-     * @return Socket file descriptor
+     * @return Client IP address in dotted notation
      */
-    int getSocket() const { return socket_; }
+    std::string getIp() const;
     
     /**
      * @brief Get the client IP address
      * 
-     * @return Client IP address
+     * @return Client IPv4 address in network byte order
      */
-    const std::string& getIp() const { return ip_; }
+    uint32_t getAddress() const { return address_.load(std::memory_order_relaxed); }
     
     /**
      * @brief Get the connection creation time
      * 
      * @return Connection creation time
      */
-    std::chrono::system_clock::time_point getCreationTime() const { return creation_time_; }
+    std::chrono::system_clock::time_point getCreationTime() const {
+        return std::chrono::system_clock::time_point(std::chrono::system_clock::duration(creation_time_.load(std::memory_order_relaxed)));
+    }
     
     /**
      * @brief Get the last activity time
      * 
      * @return Last activity time
      */
-    std::chrono::system_clock::time_point getLastActivity() const { return last_activity_; }
+    std::chrono::system_clock::time_point getLastActivity() const {
+        return std::chrono::system_clock::time_point(std::chrono::system_clock::duration(last_activity_.load(std::memory_order_relaxed)));
+    }
     
     /**
      * @brief Update the last activity time to now
@@ -62,55 +83,143 @@ public:
     void updateLastActivity();
     
     /**
-     * @brief Check if the connection is active
+     * @brief Check if the slot holds an open connection
      * 
      * @return true if active, false otherwise
      */
-    bool isActive() const { return is_active_; }
+    bool isActive() const { return is_active_.load(std::memory_order_acquire); }
     
     /**
-     * @brief Mark the connection as inactive
+     * @brief Mark the connection as closed and the slot as free
      */
-    void markInactive() { is_active_ = false; }
+    void markInactive() { is_active_.store(false, std::memory_order_release); }
     
     /**
      * @brief Get the number of requests processed
      * 
      * @return Request count
      */
-    uint64_t getRequestCount() const { return request_count_; }
+    uint64_t getRequestCount() const { return request_count_.load(std::memory_order_relaxed); }
     
     /**
      * @brief Increment the request count
      */
-    void incrementRequestCount() { request_count_++; }
+    void incrementRequestCount() { request_count_.fetch_add(1, std::memory_order_relaxed); }
+    
+    /**
+     * @brief Get the receive buffer and frame parser for this connection
+     * 
+     * @return Reference to the connection's framer
+     */
+    MbapFramer& getFramer() { return *framer_; }
+    
+    /**
+     * @brief Get the queue of responses waiting to be sent on this connection
+     * 
+     * @return Reference to the connection's response queue
+     */
+    ResponseQueue& getResponses() { return *responses_; }
+    
+    /**
+     * @brief Get the reaper timer that enforces this connection's deadlines
+     * 
+     * @return Reference to the timer node
+     */
+    TimerWheel::Timer& getTimer() { return timer_; }
+    
+    /**
+     * @brief Record that a complete request was received
+     * 
+     * @param now_ms Current time, see TimerWheel::now_ms()
+     */
+    void markRequest(uint64_t now_ms) { last_request_ms_ = now_ms; partial_since_ms_ = 0; }
+    
+    /**
+     * @brief Record that an incomplete frame is buffered
+     * 
+     * @param now_ms Current time, see TimerWheel::now_ms()
+     */
+    void markPartialFrame(uint64_t now_ms) {
+        if (partial_since_ms_ == 0) {
+            partial_since_ms_ = now_ms;
+        }
+    }
+    
+    /**
+     * @brief Get the time of the last complete request
+     * 
+     * @return Time in TimerWheel::now_ms() units
+     */
+    uint64_t getLastRequestTime() const { return last_request_ms_; }
+    
+    /**
+     * @brief Get the time since which an incomplete frame has been buffered
+     * 
+     * @return Time in TimerWheel::now_ms() units, 0 if no partial frame is pending
+     */
+    uint64_t getPartialFrameTime() const { return partial_since_ms_; }
+    
+    /**
+     * @brief Take one request from the connection's token bucket
+     * 
+     * The bucket refills at rate requests per second up to burst requests.
+     * 
+     * @param now_ms Current time, see TimerWheel::now_ms()
+     * @param rate Sustained requests per second
+     * @param burst Bucket capacity in requests
+     * @return false if the request exceeds the rate limit
+     */
+    bool takeRequestToken(uint64_t now_ms, uint64_t rate, uint64_t burst);
+    
+    /**
+     * @brief Get the scheduling weight of this connection
+     * 
+     * @return Priority weight, 0 while it still depends on the unit ID of the first request
+     */
+    int getPriority() const { return priority_; }
+    
+    /**
+     * @brief Set the scheduling weight of this connection
+     * 
+     * @param weight Priority weight, 0 to resolve it from the first request
+     */
+    void setPriority(int weight) { priority_ = weight; }
     
 private:
-    int socket_;                                    ///< Socket file descriptor
-    std::string ip_;                                ///< Client IP address
-    std::chrono::system_clock::time_point creation_time_; ///< Connection creation time
-    std::chrono::system_clock::time_point last_activity_; ///< Last activity time
-    std::atomic<bool> is_active_{true};             ///< Whether the connection is active
+    std::atomic<int> socket_{-1};                   ///< Socket file descriptor
+    std::atomic<uint32_t> address_{0};              ///< Client IPv4 address, network byte order
+    std::atomic<int64_t> creation_time_{0};         ///< Connection creation time (system_clock ticks)
+    std::atomic<int64_t> last_activity_{0};         ///< Last activity time (system_clock ticks)
+    std::atomic<bool> is_active_{false};            ///< Whether the slot holds an open connection
     std::atomic<uint64_t> request_count_{0};        ///< Number of requests processed
+    std::unique_ptr<MbapFramer> framer_;            ///< Receive buffer and ADU parser, allocated on first use
+    std::unique_ptr<ResponseQueue> responses_;      ///< Encoded responses not yet sent, allocated on first use
+    TimerWheel::Timer timer_;                       ///< Idle/partial-frame deadline on the worker's wheel
+    uint64_t last_request_ms_ = 0;                  ///< Last complete request (owning worker only)
+    uint64_t partial_since_ms_ = 0;                 ///< Start of a stalled partial frame (owning worker only)
+    uint64_t tokens_ = 0;                           ///< Rate limit bucket level in 1/1000 requests (owning worker only)
+    uint64_t tokens_refilled_ms_ = 0;               ///< Last bucket refill (owning worker only)
+    int priority_ = 1;                              ///< Scheduling weight (owning worker only)
 };
 
 /**
  * @class ModbusServer
- * @brief Implements a Modbus TCP server that runs in its own thread.
+ * @brief Implements a Modbus TCP server that runs in its own worker threads.
  * 
  * This class provides a Modbus TCP server that handles client connections
- * and processes Modbus protocol messages. It runs in a separate thread to
- * allow concurrent operation with other services.
+ * and processes Modbus protocol messages. Each worker thread runs its own
+ * event loop on its own SO_REUSEPORT listening socket, so connections are
+ * spread across cores and run concurrently with other services.
  */
 class ModbusServer {
 public:
     /**
-     * @brief Constructor - initializes the server and starts the thread
+     * @brief Constructor - initializes the server and starts the worker threads
      */
     ModbusServer();
     
     /**
-     * @brief Destructor - stops the server thread and cleans up resources
+     * @brief Destructor - stops the worker threads and cleans up resources
      */
     ~ModbusServer();
     
@@ -127,20 +236,10 @@ public:
     int poll();
     
     /**
-     * @brief Get the Modbus mapping used by this server
-     * @return Pointer to the mapping structure
+     * @brief Get the process image served by this server
+     * @return Reference to the process image
      */
-    modbus_mapping_t* get_mapping();
-    
-    /**
-     * @brief Lock the mapping mutex to protect access to the mapping
-     */
-    void lock_mapping();
-    
-    /**
-     * @brief Unlock the mapping mutex
-     */
-    void unlock_mapping();
+    ProcessImage& get_image();
     
     /**
      * @brief Get the number of active connections
@@ -156,9 +255,128 @@ public:
     
 private:
     /**
-     * @brief Main server thread function
+     * @brief Worker reactor thread function
+     * @param worker_id Index of the worker, used for CPU pinning and logging
+     */
+    void run_server(int worker_id);
+    
+#ifdef __linux__
+    /**
+     * @brief Edge-triggered epoll event loop (Linux)
+     * @param server_socket Listening socket
+     * @param report_stats Whether this loop prints periodic statistics
+     */
+    void run_epoll_loop(int server_socket, bool report_stats);
+#endif
+    
+#ifdef SIMPLEPLC_HAVE_IO_URING
+    /**
+     * @brief io_uring event loop using multishot accept/recv and a provided buffer ring
+     * @param server_socket Listening socket
+     * @param report_stats Whether this loop prints periodic statistics
+     * @return false if the ring could not be set up and nothing was served
+     */
+    bool run_uring_loop(int server_socket, bool report_stats);
+#endif
+    
+    /**
+     * @brief Portable select() event loop, used where epoll is unavailable
+     * @param server_socket Listening socket
+     * @param report_stats Whether this loop prints periodic statistics
+     */
+    void run_select_loop(int server_socket, bool report_stats);
+    
+    /**
+     * @brief Accept and register one pending client connection
+     * @param server_socket Listening socket
+     * @param client_socket Set to the accepted socket, or -1 if it was rejected
+     * @return false once the accept queue is empty or accept() failed
+     */
+    bool accept_client(int server_socket, int& client_socket);
+    
+    /**
+     * @brief Configure and start tracking a freshly accepted client socket
+     * @param client_socket Accepted socket, closed on failure
+     * @param client_addr Peer address
+     * @return true if the connection was admitted
+     */
+    bool admit_client(int client_socket, const struct sockaddr_in& client_addr);
+    
+    /**
+     * @brief Read from a ready client socket, answer complete requests and flush the responses
+     * @param socket_fd Client socket
+     * @param budget Requests this connection may have answered in the current round, decremented
+     * @return Whether the connection is drained, still has work, or must be closed
+     */
+    FairScheduler::Outcome handle_client_readable(int socket_fd, int& budget);
+    
+    /**
+     * @brief Answer the complete requests buffered in a connection's framer
+     * 
+     * Stops early when the budget is used up or the response queue is full;
+     * the remaining requests stay buffered.
+     * 
+     * @param socket_fd Client socket
+     * @param connection Connection owning the receive buffer
+     * @param budget Requests that may still be answered, decremented per request
+     * @return false if the stream is malformed and the connection should be closed
+     */
+    bool dispatch_frames(int socket_fd, ClientConnection& connection, int& budget);
+    
+    /**
+     * @brief Get the scheduling weight configured for a client address
+     * @param address Client IPv4 address in network byte order
+     * @return Priority weight, 0 if it depends on the unit ID of the requests
+     */
+    int priority_for_address(uint32_t address) const;
+    
+    /**
+     * @brief Answer a single complete request into the response queue
+     *
+     * Always queues exactly one response; a request that fails while it is
+     * handled is answered with exception 0x04 (Server Device Failure).
+     *
+     * @param responses Queue the response is appended to, with room for one more
+     * @param query Complete ADU, MBAP header included
+     * @param rc Length of the ADU
      */
-    void run_server();
+    void process_request(ResponseQueue& responses, const uint8_t* query, int rc);
+    
+    /**
+     * @brief Schedule a client's next idle or partial-frame deadline on a worker's reaper wheel
+     * @param reaper Timer wheel of the worker owning the connection
+     * @param socket_fd Client socket
+     */
+    void arm_reaper(TimerWheel& reaper, int socket_fd);
+    
+    /**
+     * @brief Get the next client whose idle or partial-frame deadline has passed
+     * 
+     * Due timers of clients that were active in the meantime are re-armed for
+     * their actual deadline. Call after TimerWheel::advance().
+     * 
+     * @param reaper Timer wheel of the calling worker
+     * @param now_ms Current time, see TimerWheel::now_ms()
+     * @return Socket of a client to close, or -1 if there is none
+     */
+    int next_expired_client(TimerWheel& reaper, uint64_t now_ms);
+    
+    /**
+     * @brief Close a client socket and stop tracking it
+     * @param socket_fd Client socket
+     */
+    void close_client(int socket_fd);
+    
+    /**
+     * @brief Close every tracked client socket
+     */
+    void close_all_clients();
+    
+    /**
+     * @brief Print statistics if the reporting interval has elapsed
+     * @param last_stats_time Time of the previous report, updated when printing
+     */
+    void print_periodic_statistics(std::chrono::steady_clock::time_point& last_stats_time);
     
     /**
      * @brief Configure a client socket
@@ -168,12 +386,25 @@ private:
     bool configure_client_socket(int client_socket);
     
     /**
-     * @brief Add a new client connection
+     * @brief Count a new client against the global and per-IP connection limits
+     * @param address Client IPv4 address in network byte order
+     * @return false if a limit is reached and the client must be refused
+     */
+    bool reserve_admission(uint32_t address);
+    
+    /**
+     * @brief Give back a connection counted by reserve_admission()
+     * @param address Client IPv4 address in network byte order
+     */
+    void release_admission(uint32_t address);
+    
+    /**
+     * @brief Start tracking a new client connection in its descriptor's slot
      * @param socket Client socket
-     * @param ip Client IP address
-     * @return Pointer to the new connection object
+     * @param address Client IPv4 address in network byte order
+     * @return Pointer to the connection slot, or nullptr if the descriptor is beyond the table
      */
-    std::shared_ptr<ClientConnection> addConnection(int socket, const std::string& ip);
+    ClientConnection* addConnection(int socket, uint32_t address);
     
     /**
      * @brief Remove a client connection
@@ -184,24 +415,32 @@ private:
     /**
      * @brief Get a client connection by socket
      * @param socket Client socket
-     * @return Pointer to the connection object, or nullptr if not found
+     * @return Pointer to the connection slot, or nullptr if no connection is open on it
      */
-    std::shared_ptr<ClientConnection> getConnection(int socket);
+    ClientConnection* getConnection(int socket);
     
-    modbus_mapping_t* mapping_ = nullptr;  ///< Modbus data mapping
-    std::thread* thread_ = nullptr;        ///< Server thread
-    std::mutex mapping_mutex; ///< Mutex to protect access to the Modbus mapping
-    std::mutex connections_mutex; ///< Mutex to protect access to the connections map
+    ProcessImage image_;                   ///< Coils and registers served to clients
+    ResponseCache response_cache_;         ///< Encoded responses to repeated reads
+    std::vector<std::thread> workers_;     ///< Worker reactor threads
     
     // Connection tracking
-    std::map<int, std::shared_ptr<ClientConnection>> connections_; ///< Map of socket FD to connection object
+    std::unique_ptr<ClientConnection[]> connections_; ///< Connection slots indexed by socket FD
+    size_t connection_capacity_ = 0; ///< Number of slots in connections_
+    std::atomic<size_t> active_connections_{0}; ///< Number of slots in use
     std::atomic<uint64_t> total_connections_{0}; ///< Total number of connections since server start
     std::atomic<uint64_t> total_requests_{0}; ///< Total number of requests since server start
-    std::chrono::system_clock::time_point start_time_; ///< Server start time
+    std::atomic<uint64_t> throttled_requests_{0}; ///< Requests refused by the rate limit
+    std::atomic<uint64_t> rejected_connections_{0}; ///< Connections refused by the connection limits
     
-    /**
-     * @brief Clean up inactive connections
-     */
-    void cleanup_inactive_connections();
+    // Admission control, only touched when clients connect or disconnect
+    std::mutex admission_mutex_; ///< Protects admitted_ and admitted_per_ip_
+    size_t admitted_ = 0; ///< Connections counted against max_connections
+    std::unordered_map<uint32_t, int> admitted_per_ip_; ///< Connections per client address
+    
+    // Scheduling weights from [Priority], read-only once the workers run
+    std::unordered_map<uint32_t, int> address_priorities_; ///< Weight per client address
+    int unit_priorities_[256] = {}; ///< Weight per unit ID, 0 = none configured
+    bool has_unit_priorities_ = false; ///< Whether any unit ID rule exists
+    std::chrono::system_clock::time_point start_time_; ///< Server start time
 };
 
@@ -0,0 +1,379 @@
+/**
+ * @file server_uring.cpp
+ * @brief io_uring transport backend for ModbusServer
+ *
+ * Only built when CMake is configured with SIMPLEPLC_WITH_IO_URING=ON and
+ * selected at runtime with "backend = io_uring" in [ModbusServer]. Accepts
+ * and receives are multishot requests that stay armed, received data lands
+ * in a provided buffer ring registered with the kernel, queued responses
+ * leave as sendmsg SQEs, and closes are a shutdown SQE hard-linked to a close
+ * SQE. All submissions and completions of one wakeup are batched, so a steady
+ * stream of requests costs roughly one io_uring_enter() per loop iteration
+ * instead of one syscall per readiness event, read, reply and close.
+ *
+ * Sends do not use registered (fixed) buffers: a response queue gathers many
+ * small responses into one sendmsg iovec, which fixed-buffer sends cannot
+ * describe, and the responses are not in a registered region to begin with.
+ */
+#include "platform.h"  // Include platform.h first for platform-specific definitions
+#include "server.h"
+#include "device_config.h"
+#include <liburing.h>
+#include <netinet/in.h>
+#include <iostream>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+
+// Defined in server.cpp
+extern std::atomic<bool> server_running;
+
+namespace {
+    constexpr unsigned RING_ENTRIES = 1024;
+    constexpr unsigned BUFFER_COUNT = 512;         // Must be a power of two
+    constexpr unsigned BUFFER_SIZE = 2048;
+    constexpr int BUFFER_GROUP = 0;
+    constexpr unsigned CQE_BATCH = 256;
+    constexpr long long WAIT_TIMEOUT_NS = 100'000'000;  // Upper bound for noticing server_running changes
+    constexpr size_t MAX_BACKLOG = 64 * 1024;          // Received bytes held while responses are in flight
+    constexpr int CLOSE_DRAIN_WAITS = 10;              // WAIT_TIMEOUT_NS waits for queued closes at shutdown
+
+    enum class Op : uint64_t {
+        Accept = 1,
+        Recv = 2,
+        Send = 3,
+        Shutdown = 4,
+        Close = 5
+    };
+
+    /**
+     * Per-descriptor state of the io_uring loop
+     */
+    struct UringConnection {
+        uint32_t generation = 0;        // See encode()
+        bool send_in_flight = false;    // A sendmsg SQE owns the response queue's pending bytes
+        std::vector<uint8_t> backlog;   // Received bytes the framer had no room for yet
+    };
+
+    // user_data layout: operation (8 bits) | connection generation (24 bits) | fd (32 bits)
+    // The generation tells completions of a closed connection apart from a new
+    // connection that was handed the same descriptor number.
+    uint64_t encode(Op op, uint32_t generation, int fd) {
+        return (static_cast<uint64_t>(op) << 56) |
+               (static_cast<uint64_t>(generation & 0xFFFFFF) << 32) |
+               static_cast<uint32_t>(fd);
+    }
+
+    Op decode_op(uint64_t data) { return static_cast<Op>(data >> 56); }
+    uint32_t decode_generation(uint64_t data) { return static_cast<uint32_t>((data >> 32) & 0xFFFFFF); }
+    int decode_fd(uint64_t data) { return static_cast<int>(data & 0xFFFFFFFF); }
+}
+
+bool ModbusServer::run_uring_loop(int server_socket, bool report_stats) {
+    struct io_uring ring;
+    int ret = io_uring_queue_init(RING_ENTRIES, &ring, 0);
+    if (ret < 0) {
+        std::cerr << "[Modbus] io_uring setup failed: " << strerror(-ret) << ", falling back to epoll" << std::endl;
+        return false;
+    }
+
+    struct io_uring_buf_ring* buffer_ring = io_uring_setup_buf_ring(&ring, BUFFER_COUNT, BUFFER_GROUP, 0, &ret);
+    if (!buffer_ring) {
+        std::cerr << "[Modbus] io_uring buffer ring setup failed: " << strerror(-ret) << ", falling back to epoll" << std::endl;
+        io_uring_queue_exit(&ring);
+        return false;
+    }
+
+    // Hand every receive buffer to the kernel up front
+    std::vector<uint8_t> buffer_storage(static_cast<size_t>(BUFFER_COUNT) * BUFFER_SIZE);
+    const int buffer_mask = io_uring_buf_ring_mask(BUFFER_COUNT);
+    auto provide_buffer = [&](unsigned short buffer_id, int offset) {
+        io_uring_buf_ring_add(buffer_ring, &buffer_storage[static_cast<size_t>(buffer_id) * BUFFER_SIZE],
+                              BUFFER_SIZE, buffer_id, buffer_mask, offset);
+    };
+    for (unsigned i = 0; i < BUFFER_COUNT; i++) {
+        provide_buffer(static_cast<unsigned short>(i), static_cast<int>(i));
+    }
+    io_uring_buf_ring_advance(buffer_ring, static_cast<int>(BUFFER_COUNT));
+
+    // Indexed by descriptor like the server's connection table
+    std::vector<UringConnection> states(connection_capacity_);
+
+    auto get_sqe = [&]() {
+        struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        if (!sqe) {
+            // Submission queue full: flush it and retry
+            io_uring_submit(&ring);
+            sqe = io_uring_get_sqe(&ring);
+        }
+        return sqe;
+    };
+
+    auto arm_accept = [&]() {
+        struct io_uring_sqe* sqe = get_sqe();
+        io_uring_prep_multishot_accept(sqe, server_socket, nullptr, nullptr, 0);
+        io_uring_sqe_set_data64(sqe, encode(Op::Accept, 0, server_socket));
+    };
+
+    auto arm_recv = [&](int fd) {
+        struct io_uring_sqe* sqe = get_sqe();
+        io_uring_prep_recv_multishot(sqe, fd, nullptr, 0, 0);
+        io_uring_sqe_set_flags(sqe, IOSQE_BUFFER_SELECT);
+        sqe->buf_group = BUFFER_GROUP;
+        io_uring_sqe_set_data64(sqe, encode(Op::Recv, states[static_cast<size_t>(fd)].generation, fd));
+    };
+
+    FairScheduler scheduler(connection_capacity_, DeviceConfig::getModbusConfig().fair_quantum);
+
+    // Closes queued in the ring whose completion has not been seen yet
+    int pending_closes = 0;
+
+    auto close_connection = [&](int fd) {
+        UringConnection& state = states[static_cast<size_t>(fd)];
+        // The descriptor number may go to another worker's connection once closed
+        scheduler.remove(fd);
+        removeConnection(fd);
+        // Any completion still in flight for this fd becomes stale
+        state.generation++;
+        state.send_in_flight = false;
+        state.backlog.clear();
+        state.backlog.shrink_to_fit();
+
+        // The shutdown terminates the armed multishot recv so the kernel drops its file
+        // reference; the hard link runs the close even when the shutdown fails. Both
+        // SQEs must go in one submission or the link would be cut.
+        if (io_uring_sq_space_left(&ring) < 2) {
+            io_uring_submit(&ring);
+        }
+        struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_shutdown(sqe, fd, SHUT_RDWR);
+        io_uring_sqe_set_flags(sqe, IOSQE_IO_HARDLINK);
+        io_uring_sqe_set_data64(sqe, encode(Op::Shutdown, state.generation, fd));
+        sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_close(sqe, fd);
+        io_uring_sqe_set_data64(sqe, encode(Op::Close, state.generation, fd));
+        pending_closes++;
+    };
+
+    auto complete_close = [&](struct io_uring_cqe* cqe) {
+        pending_closes--;
+        if (cqe->res < 0) {
+            std::cerr << "[Modbus] Closing socket " << decode_fd(io_uring_cqe_get_data64(cqe))
+                      << " failed: " << strerror(-cqe->res) << std::endl;
+        }
+    };
+
+    // Answer buffered requests within the connection's budget and queue one sendmsg for
+    // everything that is ready to go
+    auto serve = [&](int fd, int& budget) {
+        ClientConnection* connection = getConnection(fd);
+        if (!connection) {
+            // Closed while it was waiting on the ready list
+            return FairScheduler::Outcome::Drained;
+        }
+        UringConnection& state = states[static_cast<size_t>(fd)];
+        MbapFramer& framer = connection->getFramer();
+        ResponseQueue& responses = connection->getResponses();
+
+        for (;;) {
+            if (!dispatch_frames(fd, *connection, budget)) {
+                close_connection(fd);
+                return FairScheduler::Outcome::Closed;
+            }
+            if (budget <= 0 || state.backlog.empty()) {
+                break;
+            }
+            // Feed held-back bytes as the framer frees up
+            size_t taken = framer.append(state.backlog.data(), state.backlog.size());
+            if (taken == 0) {
+                break;
+            }
+            state.backlog.erase(state.backlog.begin(), state.backlog.begin() + static_cast<std::ptrdiff_t>(taken));
+        }
+
+        if (framer.pending() > 0 && !framer.has_frame()) {
+            // Partial frame buffered, held to frame_timeout_ms by the reaper
+            connection->markPartialFrame(TimerWheel::now_ms());
+        }
+
+        if (!state.send_in_flight && !responses.empty()) {
+            struct io_uring_sqe* sqe = get_sqe();
+            io_uring_prep_sendmsg(sqe, fd, responses.prepare_message(), MSG_NOSIGNAL);
+            io_uring_sqe_set_data64(sqe, encode(Op::Send, state.generation, fd));
+            state.send_in_flight = true;
+        }
+
+        // Out of budget with requests still buffered: continue next round. A full
+        // response queue instead waits for the send completion to reactivate it.
+        bool more = framer.has_frame() || !state.backlog.empty();
+        return budget <= 0 && more && !responses.full() ? FairScheduler::Outcome::Backlogged
+                                                        : FairScheduler::Outcome::Drained;
+    };
+
+    arm_accept();
+
+    auto last_stats_time = std::chrono::steady_clock::now();
+    struct io_uring_cqe* cqes[CQE_BATCH];
+    TimerWheel reaper(TimerWheel::now_ms());
+
+    while (server_running) {
+        struct __kernel_timespec timeout{};
+        timeout.tv_nsec = WAIT_TIMEOUT_NS;
+        struct io_uring_cqe* first = nullptr;
+
+        // One syscall submits everything queued since the last pass and waits for completions,
+        // unless clients still have work left from the previous round
+        if (scheduler.idle()) {
+            ret = io_uring_submit_and_wait_timeout(&ring, &first, 1, &timeout, nullptr);
+        } else {
+            ret = io_uring_submit(&ring);
+        }
+        if (ret < 0 && ret != -ETIME && ret != -EINTR) {
+            std::cerr << "[Modbus] io_uring wait error: " << strerror(-ret) << std::endl;
+        }
+
+        unsigned count = io_uring_peek_batch_cqe(&ring, cqes, CQE_BATCH);
+        for (unsigned i = 0; i < count; i++) {
+            struct io_uring_cqe* cqe = cqes[i];
+            uint64_t data = io_uring_cqe_get_data64(cqe);
+            bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+
+            if (decode_op(data) == Op::Accept) {
+                if (cqe->res >= 0) {
+                    int client_socket = cqe->res;
+                    struct sockaddr_in client_addr{};
+                    socklen_t addrlen = sizeof(client_addr);
+                    getpeername(client_socket, reinterpret_cast<struct sockaddr*>(&client_addr), &addrlen);
+
+                    if (admit_client(client_socket, client_addr)) {
+                        arm_recv(client_socket);
+                        arm_reaper(reaper, client_socket);
+                    }
+                } else if (cqe->res != -ECANCELED) {
+                    std::cerr << "[Modbus] Accept error: " << strerror(-cqe->res) << std::endl;
+                }
+
+                if (!more) {
+                    arm_accept();
+                }
+                continue;
+            }
+
+            if (decode_op(data) == Op::Shutdown) {
+                // Fails harmlessly when the peer already reset the connection
+                continue;
+            }
+            if (decode_op(data) == Op::Close) {
+                complete_close(cqe);
+                continue;
+            }
+
+            int fd = decode_fd(data);
+            bool stale = static_cast<size_t>(fd) >= states.size() ||
+                         states[static_cast<size_t>(fd)].generation != decode_generation(data);
+
+            if (decode_op(data) == Op::Send) {
+                if (stale) {
+                    continue;
+                }
+                ClientConnection* connection = getConnection(fd);
+                if (connection && cqe->res >= 0) {
+                    states[static_cast<size_t>(fd)].send_in_flight = false;
+                    connection->getResponses().complete(static_cast<size_t>(cqe->res));
+                    // Requests that waited for queue space, and any remainder of a short send
+                    scheduler.activate(fd, connection->getPriority());
+                } else {
+                    close_connection(fd);
+                }
+                continue;
+            }
+
+            const uint8_t* received = nullptr;
+            unsigned short buffer_id = 0;
+            bool has_buffer = (cqe->flags & IORING_CQE_F_BUFFER) != 0;
+            if (has_buffer) {
+                buffer_id = static_cast<unsigned short>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+                received = &buffer_storage[static_cast<size_t>(buffer_id) * BUFFER_SIZE];
+            }
+
+            if (!stale) {
+                bool keep_open = true;
+
+                if (cqe->res > 0 && received) {
+                    ClientConnection* connection = getConnection(fd);
+                    keep_open = connection != nullptr;
+
+                    if (keep_open) {
+                        UringConnection& state = states[static_cast<size_t>(fd)];
+                        size_t length = static_cast<size_t>(cqe->res);
+                        size_t taken = state.backlog.empty() ? connection->getFramer().append(received, length) : 0;
+
+                        // Whatever the framer cannot hold waits in the backlog, in order
+                        state.backlog.insert(state.backlog.end(), received + taken, received + length);
+                        if (state.backlog.size() > MAX_BACKLOG) {
+                            std::cerr << "[Modbus] Client on socket " << fd
+                                      << " pipelines without reading responses, closing connection" << std::endl;
+                            keep_open = false;
+                        } else {
+                            connection->updateLastActivity();
+                            scheduler.activate(fd, connection->getPriority());
+                        }
+                    }
+                } else if (cqe->res == 0) {
+                    std::cout << "[Modbus] Connection closed on socket " << fd << std::endl;
+                    keep_open = false;
+                } else if (cqe->res != -ENOBUFS) {
+                    // -ENOBUFS only means the buffer ring ran dry; the recv is simply re-armed
+                    keep_open = false;
+                }
+
+                if (!keep_open) {
+                    close_connection(fd);
+                } else if (!more) {
+                    arm_recv(fd);
+                }
+            }
+
+            if (has_buffer) {
+                // Recycle the buffer once its bytes have been copied out
+                provide_buffer(buffer_id, 0);
+                io_uring_buf_ring_advance(buffer_ring, 1);
+            }
+        }
+        io_uring_cq_advance(&ring, count);
+
+        scheduler.run_round(serve);
+
+        // Evict idle and stalled clients
+        uint64_t now_ms = TimerWheel::now_ms();
+        reaper.advance(now_ms);
+        for (int expired; (expired = next_expired_client(reaper, now_ms)) != -1;) {
+            close_connection(expired);
+        }
+
+        if (report_stats) {
+            print_periodic_statistics(last_stats_time);
+        }
+    }
+
+    // Closes queued in the last pass may not even be submitted yet; the descriptors
+    // would leak if the ring went away first
+    for (int waits = 0; pending_closes > 0 && waits < CLOSE_DRAIN_WAITS; waits++) {
+        struct __kernel_timespec timeout{};
+        timeout.tv_nsec = WAIT_TIMEOUT_NS;
+        struct io_uring_cqe* first = nullptr;
+        io_uring_submit_and_wait_timeout(&ring, &first, 1, &timeout, nullptr);
+
+        unsigned count = io_uring_peek_batch_cqe(&ring, cqes, CQE_BATCH);
+        for (unsigned i = 0; i < count; i++) {
+            if (decode_op(io_uring_cqe_get_data64(cqes[i])) == Op::Close) {
+                complete_close(cqes[i]);
+            }
+        }
+        io_uring_cq_advance(&ring, count);
+    }
+
+    io_uring_free_buf_ring(&ring, buffer_ring, BUFFER_COUNT, BUFFER_GROUP);
+    io_uring_queue_exit(&ring);
+    return true;
+}
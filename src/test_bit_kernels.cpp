@@ -0,0 +1,140 @@
+#include "bit_kernels.h"
+#include "test_check.h"
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Standalone checks of the bit kernels against plain bit-by-bit reference
+// loops. Every length from 0 to a few hundred bits is tried at unaligned
+// addresses, so each call runs through the AVX2 block (when the CPU has it),
+// the SSE2 block and the scalar tail in turn. Exits non-zero on failure.
+
+static const size_t MAX_BITS = 300;
+
+static bool reference_bit(const uint8_t* packed, size_t offset) {
+    return (packed[offset / 8] >> (offset % 8)) & 0x01;
+}
+
+static void reference_set(uint8_t* packed, size_t offset, bool value) {
+    auto mask = static_cast<uint8_t>(1u << (offset % 8));
+    packed[offset / 8] = static_cast<uint8_t>(value ? packed[offset / 8] | mask : packed[offset / 8] & ~mask);
+}
+
+static std::vector<uint8_t> random_bytes(std::mt19937& rng, size_t size) {
+    std::vector<uint8_t> bytes(size);
+    for (auto& byte : bytes) {
+        byte = static_cast<uint8_t>(rng());
+    }
+    return bytes;
+}
+
+static void test_pack_unpack(std::mt19937& rng) {
+    for (size_t count = 0; count <= MAX_BITS; count++) {
+        // One byte in front of each buffer keeps the vector loads unaligned
+        std::vector<uint8_t> values = random_bytes(rng, count + 1);
+        for (size_t i = 1; i <= count; i++) {
+            // Any non-zero byte is a set bit, not only 1
+            values[i] = rng() % 3 == 0 ? 0 : values[i] | 0x10;
+        }
+        std::vector<uint8_t> packed((count + 7) / 8 + 1, 0xAA);
+        bit_kernels::pack(values.data() + 1, count, packed.data() + 1);
+
+        std::vector<uint8_t> expected((count + 7) / 8 + 1, 0xAA);
+        std::fill(expected.begin() + 1, expected.end(), 0);
+        for (size_t i = 0; i < count; i++) {
+            reference_set(expected.data() + 1, i, values[i + 1] != 0);
+        }
+        if (packed != expected) {
+            std::cerr << "pack differs for " << count << " bits" << std::endl;
+            failures++;
+        }
+
+        std::vector<uint8_t> unpacked(count + 2, 0xCC);
+        bit_kernels::unpack(packed.data() + 1, count, unpacked.data() + 1);
+        bool ok = unpacked[0] == 0xCC && unpacked[count + 1] == 0xCC;
+        for (size_t i = 0; i < count; i++) {
+            ok = ok && unpacked[i + 1] == (values[i + 1] != 0 ? 1 : 0);
+        }
+        if (!ok) {
+            std::cerr << "unpack differs for " << count << " bits" << std::endl;
+            failures++;
+        }
+    }
+}
+
+static void test_first_difference(std::mt19937& rng) {
+    for (size_t size = 0; size <= MAX_BITS; size++) {
+        std::vector<uint8_t> a = random_bytes(rng, size + 1);
+        std::vector<uint8_t> b = a;
+        CHECK(bit_kernels::first_difference(a.data() + 1, b.data() + 1, size) == size);
+        for (size_t at : {size_t{0}, size / 2, size - 1}) {
+            if (size == 0) {
+                break;
+            }
+            b = a;
+            b[at + 1] ^= static_cast<uint8_t>(1u << (rng() % 8));
+            // A later difference must not hide the first one
+            if (at + 2 <= size) {
+                b[size] ^= 0xFF;
+            }
+            CHECK(bit_kernels::first_difference(a.data() + 1, b.data() + 1, size) == at);
+        }
+    }
+}
+
+static void test_offsets(std::mt19937& rng) {
+    const size_t storage = (2 * MAX_BITS + 7) / 8;
+    for (int round = 0; round < 20000; round++) {
+        size_t count = rng() % MAX_BITS;
+        size_t offset = rng() % (2 * MAX_BITS - count);
+        size_t other_offset = rng() % (2 * MAX_BITS - count);
+        std::vector<uint8_t> source = random_bytes(rng, storage);
+        std::vector<uint8_t> original = random_bytes(rng, storage);
+
+        // extract: packed bits at an offset to one byte per bit
+        std::vector<uint8_t> values(count + 1, 0xCC);
+        bit_kernels::extract(source.data(), offset, count, values.data());
+        bool ok = values[count] == 0xCC;
+        for (size_t i = 0; i < count; i++) {
+            ok = ok && values[i] == (reference_bit(source.data(), offset + i) ? 1 : 0);
+        }
+        if (!ok) {
+            std::cerr << "extract differs for " << count << " bits at " << offset << std::endl;
+            failures++;
+        }
+
+        // insert: bytes back into other packed bits, leaving the rest untouched
+        std::vector<uint8_t> inserted = original;
+        std::vector<uint8_t> expected = original;
+        bit_kernels::insert(values.data(), count, inserted.data(), other_offset);
+        for (size_t i = 0; i < count; i++) {
+            reference_set(expected.data(), other_offset + i, values[i] != 0);
+        }
+        if (inserted != expected) {
+            std::cerr << "insert differs for " << count << " bits at " << other_offset << std::endl;
+            failures++;
+        }
+
+        // copy: packed to packed between two unrelated offsets
+        std::vector<uint8_t> copied = original;
+        bit_kernels::copy(source.data(), offset, copied.data(), other_offset, count);
+        expected = original;
+        for (size_t i = 0; i < count; i++) {
+            reference_set(expected.data(), other_offset + i, reference_bit(source.data(), offset + i));
+        }
+        if (copied != expected) {
+            std::cerr << "copy differs for " << count << " bits from " << offset << " to " << other_offset << std::endl;
+            failures++;
+        }
+    }
+}
+
+int main() {
+    std::mt19937 rng(2024);
+    test_pack_unpack(rng);
+    test_first_difference(rng);
+    test_offsets(rng);
+
+    return test_result("test_bit_kernels");
+}
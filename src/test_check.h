@@ -0,0 +1,28 @@
+#pragma once
+
+#include <iostream>
+
+// Shared by the standalone test programs in src/test_*.cpp. CHECK reports a
+// false condition with its file and line and carries on, so one run lists
+// every failure; checks that print their own message add to failures
+// directly. main() ends with return test_result("test_<name>").
+
+inline int failures = 0;
+
+#define CHECK(condition)                                                            \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #condition << std::endl; \
+            failures++;                                                             \
+        }                                                                           \
+    } while (0)
+
+// Prints the outcome of a test program and returns its exit status
+inline int test_result(const char* name) {
+    if (failures > 0) {
+        std::cerr << name << ": " << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << name << ": all checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,171 @@
+#include "fair_scheduler.h"
+#include "test_check.h"
+#include <iostream>
+#include <map>
+#include <vector>
+
+// Standalone checks of FairScheduler: service in activation order, shares
+// proportional to the weights, deficit carried only while backlogged, and
+// removed or closed connections never served again. Exits non-zero on failure.
+
+using Outcome = FairScheduler::Outcome;
+
+static void test_activation_order() {
+    FairScheduler scheduler(16, 4);
+    CHECK(scheduler.idle());
+    scheduler.activate(5, 1);
+    scheduler.activate(3, 1);
+    scheduler.activate(9, 1);
+    scheduler.activate(5, 1);  // Already ready: not queued twice
+    // Outside the table: ignored
+    scheduler.activate(-1, 1);
+    scheduler.activate(16, 1);
+    CHECK(!scheduler.idle());
+
+    std::vector<int> order;
+    scheduler.run_round([&](int fd, int&) {
+        order.push_back(fd);
+        return Outcome::Drained;
+    });
+    CHECK((order == std::vector<int>{5, 3, 9}));
+    CHECK(scheduler.idle());
+}
+
+static void test_weighted_shares() {
+    const int quantum = 4;
+    FairScheduler scheduler(8, quantum);
+    std::map<int, int> weights = {{1, 1}, {2, 2}, {3, 3}};
+    for (const auto& [fd, weight] : weights) {
+        scheduler.activate(fd, weight);
+    }
+
+    // Every connection always has more requests than its budget
+    std::map<int, int> served;
+    const int rounds = 100;
+    for (int round = 0; round < rounds; round++) {
+        scheduler.run_round([&](int fd, int& budget) {
+            served[fd] += budget;
+            budget = 0;
+            return Outcome::Backlogged;
+        });
+    }
+    for (const auto& [fd, weight] : weights) {
+        CHECK(served[fd] == rounds * quantum * weight);
+    }
+}
+
+static void test_deficit_carry() {
+    // Requests cost 3 units against a quantum of 4: one request most rounds, two every third
+    const int quantum = 4;
+    const int cost = 3;
+    FairScheduler scheduler(4, quantum);
+    scheduler.activate(1, 1);
+
+    int requests = 0;
+    std::vector<int> per_round;
+    const int rounds = 30;
+    for (int round = 0; round < rounds; round++) {
+        int before = requests;
+        scheduler.run_round([&](int, int& budget) {
+            while (budget >= cost) {
+                budget -= cost;
+                requests++;
+            }
+            return Outcome::Backlogged;
+        });
+        per_round.push_back(requests - before);
+    }
+    CHECK(requests == rounds * quantum / cost);
+    CHECK(per_round[0] == 1 && per_round[1] == 1 && per_round[2] == 2);
+
+    // Draining forfeits the leftover: the next activation starts from one quantum
+    int budget_seen = 0;
+    scheduler.run_round([&](int, int& budget) {
+        budget -= cost;
+        return Outcome::Drained;
+    });
+    scheduler.activate(1, 1);
+    scheduler.run_round([&](int, int& budget) {
+        budget_seen = budget;
+        return Outcome::Drained;
+    });
+    CHECK(budget_seen == quantum);
+}
+
+static void test_chatty_client() {
+    // A client that never runs dry gets one quantum per round; a quiet one is served every round
+    const int quantum = 8;
+    FairScheduler scheduler(8, quantum);
+    scheduler.activate(4, 1);
+
+    int chatty = 0;
+    int quiet = 0;
+    for (int round = 0; round < 50; round++) {
+        scheduler.activate(6, 1);
+        scheduler.run_round([&](int fd, int& budget) {
+            if (fd == 4) {
+                chatty += budget;
+                budget = 0;
+                return Outcome::Backlogged;
+            }
+            quiet++;
+            budget--;
+            return Outcome::Drained;
+        });
+        CHECK(quiet == round + 1);
+        CHECK(chatty == (round + 1) * quantum);
+    }
+}
+
+static void test_remove_and_close() {
+    FairScheduler scheduler(8, 2);
+    scheduler.activate(1, 1);
+    scheduler.activate(2, 1);
+    scheduler.activate(3, 1);
+    scheduler.remove(2);
+    scheduler.remove(7);    // Not ready: no effect
+    scheduler.remove(100);  // Outside the table: ignored
+
+    std::vector<int> served;
+    scheduler.run_round([&](int fd, int& budget) {
+        served.push_back(fd);
+        budget = 0;
+        return fd == 1 ? Outcome::Closed : Outcome::Backlogged;
+    });
+    CHECK((served == std::vector<int>{1, 3}));
+
+    // Closed connections are dropped, backlogged ones come back
+    served.clear();
+    scheduler.run_round([&](int fd, int&) {
+        served.push_back(fd);
+        return Outcome::Drained;
+    });
+    CHECK((served == std::vector<int>{3}));
+    CHECK(scheduler.idle());
+
+    // A descriptor removed while backlogged starts over without its old credit
+    scheduler.activate(5, 1);
+    scheduler.run_round([&](int, int& budget) {
+        budget = 1;
+        return Outcome::Backlogged;
+    });
+    scheduler.remove(5);
+    CHECK(scheduler.idle());
+    int budget_seen = 0;
+    scheduler.activate(5, 1);
+    scheduler.run_round([&](int, int& budget) {
+        budget_seen = budget;
+        return Outcome::Drained;
+    });
+    CHECK(budget_seen == 2);
+}
+
+int main() {
+    test_activation_order();
+    test_weighted_shares();
+    test_deficit_carry();
+    test_chatty_client();
+    test_remove_and_close();
+
+    return test_result("test_fair_scheduler");
+}
@@ -0,0 +1,139 @@
+#include "fifo_queue.h"
+#include "test_check.h"
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Standalone checks of FifoQueue: order and wraparound of the ring over many
+// times its capacity, dropping when full, and no lost or duplicated samples
+// with several producers and readers at once. Exits non-zero on failure.
+
+static void test_wraparound() {
+    FifoQueue queue;
+    uint16_t samples[FifoQueue::MAX_READ];
+    CHECK(queue.pop(samples, FifoQueue::MAX_READ) == 0);
+
+    // Uneven push and pop batches walk the indices around the ring many times
+    uint16_t pushed = 0;
+    uint16_t popped = 0;
+    for (int round = 0; round < 1000; round++) {
+        int batch = 1 + round % 37;
+        for (int i = 0; i < batch; i++) {
+            CHECK(queue.push(pushed));
+            pushed++;
+        }
+        size_t max = 1 + static_cast<size_t>(round) % FifoQueue::MAX_READ;
+        size_t count = queue.pop(samples, max);
+        CHECK(count <= max);
+        for (size_t i = 0; i < count; i++) {
+            CHECK(samples[i] == popped);
+            popped++;
+        }
+        // Drain whenever a full ring would get close
+        while (static_cast<uint16_t>(pushed - popped) > FifoQueue::CAPACITY / 2) {
+            count = queue.pop(samples, FifoQueue::MAX_READ);
+            for (size_t i = 0; i < count; i++) {
+                CHECK(samples[i] == popped);
+                popped++;
+            }
+        }
+    }
+    CHECK(pushed > 10 * FifoQueue::CAPACITY);
+}
+
+static void test_full_queue() {
+    FifoQueue queue;
+    for (size_t i = 0; i < FifoQueue::CAPACITY; i++) {
+        CHECK(queue.push(static_cast<uint16_t>(i)));
+    }
+    CHECK(!queue.push(0xFFFF));
+
+    // A read frees room for exactly as many samples as it took
+    uint16_t samples[FifoQueue::MAX_READ];
+    CHECK(queue.pop(samples, 5) == 5);
+    CHECK(samples[0] == 0 && samples[4] == 4);
+    for (int i = 0; i < 5; i++) {
+        CHECK(queue.push(static_cast<uint16_t>(FifoQueue::CAPACITY + static_cast<size_t>(i))));
+    }
+    CHECK(!queue.push(0xFFFF));
+
+    size_t expected = 5;
+    for (size_t count; (count = queue.pop(samples, FifoQueue::MAX_READ)) > 0;) {
+        for (size_t i = 0; i < count; i++) {
+            CHECK(samples[i] == static_cast<uint16_t>(expected));
+            expected++;
+        }
+    }
+    CHECK(expected == FifoQueue::CAPACITY + 5);
+}
+
+static void test_concurrent() {
+    // Each sample carries its producer in the top bits and a sequence number below
+    const int producers = 4;
+    const int readers = 3;
+    const int per_producer = 1 << 14;
+    FifoQueue queue;
+    std::atomic<int> finished_producers{0};
+    std::vector<std::vector<uint16_t>> received(readers);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+            for (int sequence = 0; sequence < per_producer; sequence++) {
+                auto sample = static_cast<uint16_t>((p << 14) | sequence);
+                while (!queue.push(sample)) {
+                    std::this_thread::yield();
+                }
+            }
+            finished_producers++;
+        });
+    }
+    for (int r = 0; r < readers; r++) {
+        threads.emplace_back([&, r] {
+            uint16_t samples[FifoQueue::MAX_READ];
+            for (;;) {
+                bool done = finished_producers == producers;
+                size_t count = queue.pop(samples, FifoQueue::MAX_READ);
+                received[static_cast<size_t>(r)].insert(received[static_cast<size_t>(r)].end(), samples, samples + count);
+                if (count == 0 && done) {
+                    break;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Every sample arrives exactly once, and each reader sees each producer's samples in order
+    std::vector<int> seen(static_cast<size_t>(producers) * per_producer, 0);
+    for (const auto& samples : received) {
+        std::vector<int> last(producers, -1);
+        for (uint16_t sample : samples) {
+            int producer = sample >> 14;
+            int sequence = sample & (per_producer - 1);
+            CHECK(sequence > last[static_cast<size_t>(producer)]);
+            last[static_cast<size_t>(producer)] = sequence;
+            seen[static_cast<size_t>(sample)]++;
+        }
+    }
+    int missing = 0;
+    int duplicated = 0;
+    for (int count : seen) {
+        missing += count == 0;
+        duplicated += count > 1;
+    }
+    if (missing != 0 || duplicated != 0) {
+        std::cerr << "concurrent FIFO lost " << missing << " and duplicated " << duplicated << " samples" << std::endl;
+        failures++;
+    }
+}
+
+int main() {
+    test_wraparound();
+    test_full_queue();
+    test_concurrent();
+
+    return test_result("test_fifo_queue");
+}
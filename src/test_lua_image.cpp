@@ -0,0 +1,227 @@
+#include "plc_logic.h"
+#include "device_config.h"
+#include "process_image.h"
+#include "test_check.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// Runs a Lua task against a process image and checks what its script reads
+// and writes through image.coil, image.di, image.hr and image.ir: values
+// preset before the start, unmapped addresses, writes landing in the right
+// block and nowhere else, and inputs changed while the task runs. Built with
+// SIMPLEPLC_HAVE_LUAJIT it also checks that the FFI proxies replaced the C
+// ones. Every case runs with both bit layouts. Exits non-zero on failure.
+
+using Table = ProcessImage::Table;
+using BitLayout = ProcessImage::BitLayout;
+
+// Two address blocks per table, so every proxy has to translate addresses
+static const std::vector<AddressSegment> COILS = {{0, 16}, {100, 8}};
+static const std::vector<AddressSegment> DISCRETE_INPUTS = {{0, 16}, {200, 4}};
+static const std::vector<AddressSegment> HOLDING_REGISTERS = {{0, 32}, {1000, 10}};
+static const std::vector<AddressSegment> INPUT_REGISTERS = {{0, 8}, {3000, 2}};
+
+// Set by the script once its first scan is done, and its count of failed checks
+static const int DONE_REGISTER = 1000;
+static const int FAILURES_REGISTER = 1001;
+
+// The first scan checks and writes every table once; every scan after that
+// mirrors input register 1 into holding register 1009
+static const char* const SCRIPT = R"lua(
+local failures = 0
+local function check(condition, what)
+    if not condition then
+        failures = failures + 1
+        print("check failed: " .. what)
+    end
+end
+
+local function raises(assign)
+    return not pcall(assign)
+end
+
+local first = true
+
+function cycle()
+    if first then
+        first = false
+
+        check(type(image.hr) == (EXPECT_FFI and "cdata" or "userdata"), "proxy type " .. type(image.hr))
+
+        -- Values preset by the host
+        check(image.di[3] == true and image.di[4] == false and image.di[201] == true, "discrete inputs")
+        check(image.coil[101] == true and image.coil[100] == false, "coils")
+        check(image.ir[5] == 1234 and image.ir[3000] == 65535, "input registers")
+        check(image.hr[7] == 42 and image.hr[1008] == 7, "holding registers")
+        check(modbus.readHoldingRegister(7) == image.hr[7], "proxies and modbus.* share the scan image")
+
+        -- Empty ranges succeed and change nothing, even where nothing is mapped
+        check(modbus.writeHoldingRegisters(0, {}) == true and modbus.writeCoils(50, {}) == true, "empty range write")
+        local empty = modbus.readInputRegisters(3000, 0)
+        check(type(empty) == "table" and #empty == 0, "empty range read")
+        check(modbus.writeHoldingRegisters(31, {1, 2}) == false, "range write past a block")
+
+        -- Unmapped addresses read as nil and cannot be written
+        check(image.coil[16] == nil and image.coil[99] == nil, "unmapped coil")
+        check(image.di[199] == nil and image.di[204] == nil, "unmapped discrete input")
+        check(image.hr[32] == nil and image.hr[-1] == nil and image.hr[70000] == nil, "unmapped holding register")
+        check(image.ir[8] == nil and image.ir[2999] == nil, "unmapped input register")
+        check(raises(function() image.coil[50] = true end), "write to unmapped coil")
+        check(raises(function() image.di[16] = true end), "write to unmapped discrete input")
+        check(raises(function() image.hr[999] = 1 end), "write to unmapped holding register")
+        check(raises(function() image.ir[3002] = 1 end), "write to unmapped input register")
+
+        -- Register values must be whole numbers that fit 16 bits; anything else raises on both backends
+        check(raises(function() image.hr[2] = 1.5 end), "fractional register value")
+        check(raises(function() image.hr[2] = 70000 end), "register value above 65535")
+        check(raises(function() image.hr[2] = -40000 end), "register value below -32768")
+        check(raises(function() image.ir[2] = "1" end), "string register value")
+        check(raises(function() image.hr[2] = nil end), "nil register value")
+        image.hr[30] = -1
+        check(image.hr[30] == 65535, "negative register value wraps to 16 bits")
+
+        -- Writes at both ends of every block, read back within the same scan
+        image.coil[0] = true
+        image.coil[15] = true
+        image.coil[101] = false
+        image.coil[107] = true
+        image.di[0] = true
+        image.di[203] = true
+        image.hr[0] = 1
+        image.hr[31] = 65535
+        image.hr[1005] = image.hr[7] + 1
+        image.ir[7] = 777
+        image.ir[3001] = 4321
+        check(image.coil[0] == true and image.coil[101] == false, "coil read back")
+        check(image.hr[1005] == 43 and modbus.readHoldingRegister(1005) == 43, "holding register read back")
+
+        image.hr[1001] = failures
+        image.hr[1000] = 1
+    end
+    image.hr[1009] = image.ir[1]
+end
+)lua";
+
+// Polls until condition holds, for at most a few seconds
+static bool wait_for(const std::function<bool()>& condition) {
+    for (int i = 0; i < 1000; i++) {
+        if (condition()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return false;
+}
+
+static bool bit_at(const ProcessImage& image, Table table, int address) {
+    bool value = false;
+    CHECK(image.read_bit(table, address, value));
+    return value;
+}
+
+static uint16_t register_at(const ProcessImage& image, Table table, int address) {
+    uint16_t value = 0;
+    CHECK(image.read_register(table, address, value));
+    return value;
+}
+
+static void test_proxies(BitLayout layout) {
+    ProcessImage image(COILS, DISCRETE_INPUTS, HOLDING_REGISTERS, INPUT_REGISTERS, {}, layout);
+    CHECK(image.write_bit(Table::DiscreteInputs, 3, true));
+    CHECK(image.write_bit(Table::DiscreteInputs, 201, true));
+    CHECK(image.write_bit(Table::Coils, 101, true));
+    CHECK(image.write_register(Table::InputRegisters, 5, 1234));
+    CHECK(image.write_register(Table::InputRegisters, 3000, 65535));
+    CHECK(image.write_register(Table::HoldingRegisters, 7, 42));
+    CHECK(image.write_register(Table::HoldingRegisters, 1008, 7));
+
+    PlcLogic::start(&image);
+    bool done = wait_for([&] { return register_at(image, Table::HoldingRegisters, DONE_REGISTER) == 1; });
+    CHECK(done);
+    if (done) {
+        CHECK(register_at(image, Table::HoldingRegisters, FAILURES_REGISTER) == 0);
+
+        // Each write landed at its address and its neighbours kept their values
+        for (const auto& segment : COILS) {
+            for (int address = segment.start; address < segment.start + segment.count; address++) {
+                bool expected = address == 0 || address == 15 || address == 107;
+                if (bit_at(image, Table::Coils, address) != expected) {
+                    std::cerr << "coil " << address << " should be " << expected << std::endl;
+                    failures++;
+                }
+            }
+        }
+        for (const auto& segment : DISCRETE_INPUTS) {
+            for (int address = segment.start; address < segment.start + segment.count; address++) {
+                bool expected = address == 0 || address == 3 || address == 201 || address == 203;
+                if (bit_at(image, Table::DiscreteInputs, address) != expected) {
+                    std::cerr << "discrete input " << address << " should be " << expected << std::endl;
+                    failures++;
+                }
+            }
+        }
+        for (int address = 1; address < 30; address++) {
+            if (register_at(image, Table::HoldingRegisters, address) != (address == 7 ? 42 : 0)) {
+                std::cerr << "holding register " << address << " changed" << std::endl;
+                failures++;
+            }
+        }
+        CHECK(register_at(image, Table::HoldingRegisters, 0) == 1);
+        CHECK(register_at(image, Table::HoldingRegisters, 30) == 65535);
+        CHECK(register_at(image, Table::HoldingRegisters, 31) == 65535);
+        CHECK(register_at(image, Table::HoldingRegisters, 1004) == 0);
+        CHECK(register_at(image, Table::HoldingRegisters, 1005) == 43);
+        CHECK(register_at(image, Table::HoldingRegisters, 1006) == 0);
+        CHECK(register_at(image, Table::HoldingRegisters, 1008) == 7);
+        CHECK(register_at(image, Table::InputRegisters, 5) == 1234);
+        CHECK(register_at(image, Table::InputRegisters, 2) == 0);
+        CHECK(register_at(image, Table::InputRegisters, 6) == 0);
+        CHECK(register_at(image, Table::InputRegisters, 7) == 777);
+        CHECK(register_at(image, Table::InputRegisters, 3000) == 65535);
+        CHECK(register_at(image, Table::InputRegisters, 3001) == 4321);
+
+        // Inputs changed while the task runs reach the proxies of a later scan
+        for (uint16_t value : std::initializer_list<uint16_t>{500, 0, 65535}) {
+            CHECK(image.write_register(Table::InputRegisters, 1, value));
+            CHECK(wait_for([&] { return register_at(image, Table::HoldingRegisters, 1009) == value; }));
+        }
+    }
+    PlcLogic::stop();
+}
+
+int main() {
+    // A single task running the script every few milliseconds
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "simpleplc_test_lua_image";
+    std::filesystem::create_directories(directory);
+    std::filesystem::path script = directory / "image.plc";
+    std::filesystem::path settings = directory / "settings.ini";
+    {
+        std::ofstream out(script);
+#ifdef SIMPLEPLC_HAVE_LUAJIT
+        out << "EXPECT_FFI = true\n";
+#else
+        out << "EXPECT_FFI = false\n";
+#endif
+        out << SCRIPT;
+    }
+    {
+        std::ofstream out(settings);
+        out << "[Task:image]\n"
+            << "script = " << script.string() << "\n"
+            << "period_ms = 2\n";
+    }
+    DeviceConfig::load(settings.string());
+
+    test_proxies(BitLayout::Bytes);
+    test_proxies(BitLayout::Packed);
+
+    std::filesystem::remove_all(directory);
+
+    return test_result("test_lua_image");
+}
@@ -0,0 +1,190 @@
+#include "platform.h"  // Include platform.h first for platform-specific definitions
+#include "mbap_framer.h"
+#include "test_check.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Standalone checks of MbapFramer: partial headers and PDUs, several ADUs per
+// read, malformed headers and a full buffer. Exits non-zero on failure.
+
+// One ADU: MBAP header for unit 1 followed by the PDU
+static std::vector<uint8_t> adu(uint16_t transaction_id, const std::vector<uint8_t>& pdu) {
+    auto length = static_cast<uint16_t>(pdu.size() + 1);
+    std::vector<uint8_t> frame = {
+        static_cast<uint8_t>(transaction_id >> 8), static_cast<uint8_t>(transaction_id & 0xFF),
+        0, 0,
+        static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length & 0xFF),
+        1
+    };
+    frame.insert(frame.end(), pdu.begin(), pdu.end());
+    return frame;
+}
+
+static const std::vector<uint8_t> READ_HOLDING = {0x03, 0x00, 0x10, 0x00, 0x02};
+
+static void test_partial_header() {
+    MbapFramer framer;
+    std::vector<uint8_t> frame = adu(7, READ_HOLDING);
+    const uint8_t* data = nullptr;
+    int length = 0;
+
+    CHECK(framer.append(frame.data(), 3) == 3);
+    CHECK(!framer.has_frame());
+    CHECK(!framer.next_frame(data, length));
+    CHECK(framer.pending() == 3);
+
+    // Header complete, PDU still short by one byte
+    CHECK(framer.append(frame.data() + 3, frame.size() - 4) == frame.size() - 4);
+    CHECK(!framer.has_frame());
+    CHECK(!framer.next_frame(data, length));
+
+    CHECK(framer.append(frame.data() + frame.size() - 1, 1) == 1);
+    CHECK(framer.has_frame());
+    CHECK(framer.next_frame(data, length));
+    CHECK(length == static_cast<int>(frame.size()));
+    CHECK(std::equal(frame.begin(), frame.end(), data));
+    CHECK(framer.pending() == 0);
+    CHECK(!framer.malformed());
+}
+
+static void test_byte_by_byte() {
+    MbapFramer framer;
+    std::vector<uint8_t> frame = adu(1, READ_HOLDING);
+    const uint8_t* data = nullptr;
+    int length = 0;
+    for (size_t i = 0; i < frame.size(); i++) {
+        CHECK(!framer.has_frame());
+        framer.append(&frame[i], 1);
+    }
+    CHECK(framer.next_frame(data, length));
+    CHECK(length == static_cast<int>(frame.size()));
+}
+
+static void test_multiple_frames() {
+    MbapFramer framer;
+    std::vector<uint8_t> stream;
+    for (uint16_t id = 1; id <= 3; id++) {
+        std::vector<uint8_t> frame = adu(id, READ_HOLDING);
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+    // Half of a fourth ADU trails the three complete ones
+    std::vector<uint8_t> fourth = adu(4, {0x10, 0x00, 0x00, 0x00, 0x01, 0x02, 0x12, 0x34});
+    stream.insert(stream.end(), fourth.begin(), fourth.begin() + 9);
+    CHECK(framer.append(stream.data(), stream.size()) == stream.size());
+
+    const uint8_t* data = nullptr;
+    int length = 0;
+    for (uint16_t id = 1; id <= 3; id++) {
+        CHECK(framer.next_frame(data, length));
+        CHECK(length == static_cast<int>(MbapFramer::MBAP_HEADER_LENGTH + READ_HOLDING.size()));
+        CHECK(data[1] == id);
+    }
+    CHECK(!framer.next_frame(data, length));
+    CHECK(framer.pending() == 9);
+
+    // The remainder completes it after the consumed frames were compacted away
+    CHECK(framer.append(fourth.data() + 9, fourth.size() - 9) == fourth.size() - 9);
+    CHECK(framer.next_frame(data, length));
+    CHECK(length == static_cast<int>(fourth.size()));
+    CHECK(std::equal(fourth.begin(), fourth.end(), data));
+}
+
+static void test_malformed() {
+    const uint8_t* data = nullptr;
+    int length = 0;
+
+    MbapFramer wrong_protocol;
+    std::vector<uint8_t> frame = adu(1, READ_HOLDING);
+    frame[3] = 1;
+    wrong_protocol.append(frame.data(), frame.size());
+    CHECK(wrong_protocol.has_frame());  // Reported, so the caller asks next_frame()
+    CHECK(!wrong_protocol.next_frame(data, length));
+    CHECK(wrong_protocol.malformed());
+    CHECK(!wrong_protocol.has_frame());
+
+    MbapFramer too_short;
+    std::vector<uint8_t> empty = {0, 1, 0, 0, 0, 1, 1};  // Unit identifier without a function code
+    too_short.append(empty.data(), empty.size());
+    CHECK(!too_short.next_frame(data, length));
+    CHECK(too_short.malformed());
+
+    MbapFramer too_long;
+    std::vector<uint8_t> oversized = {0, 1, 0, 0, 0x01, 0x00, 1};  // 256 bytes after the length field
+    too_long.append(oversized.data(), oversized.size());
+    CHECK(!too_long.next_frame(data, length));
+    CHECK(too_long.malformed());
+
+    too_long.reset();
+    CHECK(!too_long.malformed());
+    CHECK(too_long.pending() == 0);
+}
+
+static void test_full_buffer() {
+    MbapFramer framer;
+    std::vector<uint8_t> frame = adu(1, READ_HOLDING);
+    std::vector<uint8_t> stream;
+    while (stream.size() + frame.size() <= MbapFramer::BUFFER_SIZE) {
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+    stream.insert(stream.end(), frame.begin(), frame.end());
+
+    size_t taken = framer.append(stream.data(), stream.size());
+    CHECK(taken == MbapFramer::BUFFER_SIZE);
+    CHECK(framer.append(stream.data() + taken, stream.size() - taken) == 0);
+
+    // Draining one frame frees exactly its space for the rest of the stream
+    const uint8_t* data = nullptr;
+    int length = 0;
+    CHECK(framer.next_frame(data, length));
+    size_t more = framer.append(stream.data() + taken, stream.size() - taken);
+    CHECK(more == std::min(frame.size(), stream.size() - taken));
+
+    int frames = 1;
+    while (framer.next_frame(data, length)) {
+        frames++;
+    }
+    CHECK(static_cast<size_t>(frames) == (taken + more) / frame.size());
+}
+
+#ifndef _WIN32
+static void test_receive() {
+    int sockets[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+    fcntl(sockets[0], F_SETFL, fcntl(sockets[0], F_GETFL) | O_NONBLOCK);
+
+    MbapFramer framer;
+    CHECK(framer.receive(sockets[0]) == MbapFramer::ReceiveResult::WouldBlock);
+
+    std::vector<uint8_t> frame = adu(9, READ_HOLDING);
+    CHECK(write(sockets[1], frame.data(), frame.size()) == static_cast<ssize_t>(frame.size()));
+    CHECK(framer.receive(sockets[0]) == MbapFramer::ReceiveResult::Data);
+
+    const uint8_t* data = nullptr;
+    int length = 0;
+    CHECK(framer.next_frame(data, length));
+    CHECK(data[1] == 9);
+
+    close(sockets[1]);
+    CHECK(framer.receive(sockets[0]) == MbapFramer::ReceiveResult::Closed);
+    close(sockets[0]);
+}
+#endif
+
+int main() {
+    test_partial_header();
+    test_byte_by_byte();
+    test_multiple_frames();
+    test_malformed();
+    test_full_buffer();
+#ifndef _WIN32
+    test_receive();
+#endif
+
+    return test_result("test_mbap_framer");
+}
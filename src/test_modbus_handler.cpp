@@ -0,0 +1,324 @@
+#include "platform.h"  // Include platform.h first for platform-specific definitions
+#include "modbus_handler.h"
+#include "test_check.h"
+#include <iostream>
+#include <vector>
+
+// Standalone checks of ModbusHandler::build_standard_response: crafted request
+// ADUs for every natively encoded function, compared byte for byte with what
+// modbus_reply() sends, including the exception codes for bad quantities,
+// unmapped addresses and truncated requests, and the read-modify-write of Mask
+// Write and Read/Write Multiple. Bit functions run with both bit layouts.
+// Exits non-zero on failure.
+
+using Bytes = std::vector<uint8_t>;
+using Table = ProcessImage::Table;
+using BitLayout = ProcessImage::BitLayout;
+
+// Every table has a gap, so ranges can run out of a block
+static const std::vector<AddressSegment> COILS = {{0, 20}, {100, 10}};
+static const std::vector<AddressSegment> DISCRETE_INPUTS = {{0, 20}};
+static const std::vector<AddressSegment> HOLDING_REGISTERS = {{0, 10}, {200, 130}};
+static const std::vector<AddressSegment> INPUT_REGISTERS = {{0, 10}};
+
+static uint8_t high(int value) {
+    return static_cast<uint8_t>((value >> 8) & 0xFF);
+}
+
+static uint8_t low(int value) {
+    return static_cast<uint8_t>(value & 0xFF);
+}
+
+// One ADU with transaction ID 0x1234 for unit 0x11: MBAP header followed by the PDU
+static Bytes adu(const Bytes& pdu) {
+    auto length = static_cast<int>(pdu.size() + 1);
+    Bytes frame = {0x12, 0x34, 0, 0, high(length), low(length), 0x11};
+    frame.insert(frame.end(), pdu.begin(), pdu.end());
+    return frame;
+}
+
+// PDU of a request made of a function code and two 16-bit fields, e.g. address and count
+static Bytes request(uint8_t function, int first, int second) {
+    return {function, high(first), low(first), high(second), low(second)};
+}
+
+// PDU of FC 15 or 16: address, count, byte count and the data bytes
+static Bytes write_request(uint8_t function, int address, int count, const Bytes& data) {
+    Bytes pdu = request(function, address, count);
+    pdu.push_back(static_cast<uint8_t>(data.size()));
+    pdu.insert(pdu.end(), data.begin(), data.end());
+    return pdu;
+}
+
+// count registers with the values value, value + 1, ... as big-endian bytes
+static Bytes register_bytes(int count, int value) {
+    Bytes data;
+    for (int i = 0; i < count; i++) {
+        data.push_back(high(value + i));
+        data.push_back(low(value + i));
+    }
+    return data;
+}
+
+static Bytes exception(uint8_t function, int code) {
+    return adu({static_cast<uint8_t>(function | 0x80), static_cast<uint8_t>(code)});
+}
+
+// Response ADU to a request ADU
+static Bytes respond_to(ProcessImage& image, const Bytes& query) {
+    uint8_t response[MODBUS_TCP_MAX_ADU_LENGTH];
+    int length = ModbusHandler::build_standard_response(query.data(), static_cast<int>(query.size()), image, response);
+    return Bytes(response, response + length);
+}
+
+static Bytes respond(ProcessImage& image, const Bytes& pdu) {
+    return respond_to(image, adu(pdu));
+}
+
+static bool bit_at(const ProcessImage& image, Table table, int address) {
+    bool value = false;
+    CHECK(image.read_bit(table, address, value));
+    return value;
+}
+
+static uint16_t register_at(const ProcessImage& image, Table table, int address) {
+    uint16_t value = 0;
+    CHECK(image.read_register(table, address, value));
+    return value;
+}
+
+static ProcessImage make_image(BitLayout layout) {
+    return ProcessImage(COILS, DISCRETE_INPUTS, HOLDING_REGISTERS, INPUT_REGISTERS, {}, layout);
+}
+
+static void test_read_bits(BitLayout layout) {
+    ProcessImage image = make_image(layout);
+    for (int address : {0, 2, 3, 9, 10, 19, 100, 109}) {
+        CHECK(image.write_bit(Table::Coils, address, true));
+    }
+    CHECK(image.write_bit(Table::DiscreteInputs, 1, true));
+    CHECK(image.write_bit(Table::DiscreteInputs, 17, true));
+
+    // Packed LSB first, unused high bits of the last byte zero
+    CHECK(respond(image, request(0x01, 0, 11)) == adu({0x01, 0x02, 0x0D, 0x06}));
+    CHECK(respond(image, request(0x01, 19, 1)) == adu({0x01, 0x01, 0x01}));
+    CHECK(respond(image, request(0x01, 100, 10)) == adu({0x01, 0x02, 0x01, 0x02}));
+    CHECK(respond(image, request(0x02, 0, 20)) == adu({0x02, 0x03, 0x02, 0x00, 0x02}));
+
+    // Quantity is checked before the address, as modbus_reply() does
+    for (uint8_t function : {uint8_t{0x01}, uint8_t{0x02}}) {
+        CHECK(respond(image, request(function, 0, 0)) == exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+        CHECK(respond(image, request(function, 5000, MODBUS_MAX_READ_BITS + 1)) ==
+              exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+        CHECK(respond(image, request(function, 15, 6)) == exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS));
+        CHECK(respond(image, request(function, 20, 1)) == exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS));
+    }
+    // Spans the gap between the two coil blocks
+    CHECK(respond(image, request(0x01, 19, 82)) == exception(0x01, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS));
+}
+
+static void test_read_registers() {
+    ProcessImage image = make_image(BitLayout::Bytes);
+    for (int address = 0; address < 10; address++) {
+        CHECK(image.write_register(Table::HoldingRegisters, address, static_cast<uint16_t>(0x0100 + address)));
+        CHECK(image.write_register(Table::InputRegisters, address, static_cast<uint16_t>(0xA000 + address)));
+    }
+    for (int address = 200; address < 330; address++) {
+        CHECK(image.write_register(Table::HoldingRegisters, address, static_cast<uint16_t>(address)));
+    }
+
+    CHECK(respond(image, request(0x03, 2, 3)) == adu({0x03, 0x06, 0x01, 0x02, 0x01, 0x03, 0x01, 0x04}));
+    CHECK(respond(image, request(0x04, 9, 1)) == adu({0x04, 0x02, 0xA0, 0x09}));
+
+    // The largest read fills the 250 data bytes of the PDU
+    Bytes largest = {0x03, 250};
+    Bytes values = register_bytes(MODBUS_MAX_READ_REGISTERS, 200);
+    largest.insert(largest.end(), values.begin(), values.end());
+    CHECK(respond(image, request(0x03, 200, MODBUS_MAX_READ_REGISTERS)) == adu(largest));
+
+    for (uint8_t function : {uint8_t{0x03}, uint8_t{0x04}}) {
+        CHECK(respond(image, request(function, 0, 0)) == exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+        CHECK(respond(image, request(function, 200, MODBUS_MAX_READ_REGISTERS + 1)) ==
+              exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+        CHECK(respond(image, request(function, 9, 2)) == exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS));
+        CHECK(respond(image, request(function, 65535, 1)) == exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS));
+    }
+}
+
+static void test_write_single() {
+    ProcessImage image = make_image(BitLayout::Packed);
+
+    // Both answer with an echo of the request
+    CHECK(respond(image, request(0x05, 4, 0xFF00)) == adu(request(0x05, 4, 0xFF00)));
+    CHECK(bit_at(image, Table::Coils, 4));
+    CHECK(!bit_at(image, Table::Coils, 3) && !bit_at(image, Table::Coils, 5));
+    CHECK(respond(image, request(0x05, 4, 0x0000)) == adu(request(0x05, 4, 0x0000)));
+    CHECK(!bit_at(image, Table::Coils, 4));
+    CHECK(respond(image, request(0x06, 5, 0xBEEF)) == adu(request(0x06, 5, 0xBEEF)));
+    CHECK(register_at(image, Table::HoldingRegisters, 5) == 0xBEEF);
+
+    // A coil value other than 0xFF00 or 0x0000 is refused, but only once the address is known to be valid
+    CHECK(respond(image, request(0x05, 4, 0x1234)) == exception(0x05, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+    CHECK(respond(image, request(0x05, 50, 0x1234)) == exception(0x05, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS));
+    CHECK(respond(image, request(0x06, 10, 1)) == exception(0x06, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS));
+    CHECK(!bit_at(image, Table::Coils, 4));
+}
+
+static void test_write_coils(BitLayout layout) {
+    ProcessImage image = make_image(layout);
+    CHECK(image.write_bit(Table::Coils, 0, true));
+    CHECK(image.write_bit(Table::Coils, 11, true));
+
+    // Ten coils from 1: 0xCD sets 1, 3, 4, 7 and 8, 0xFD sets 9 and clears 10; its other bits are ignored
+    CHECK(respond(image, write_request(0x0F, 1, 10, {0xCD, 0xFD})) == adu(request(0x0F, 1, 10)));
+    for (int address = 0; address < 20; address++) {
+        bool expected = address == 0 || address == 1 || address == 3 || address == 4 || address == 7 ||
+                        address == 8 || address == 9 || address == 11;
+        if (bit_at(image, Table::Coils, address) != expected) {
+            std::cerr << "coil " << address << " should be " << expected << std::endl;
+            failures++;
+        }
+    }
+
+    CHECK(respond(image, write_request(0x0F, 1, 0, {})) == exception(0x0F, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+    CHECK(respond(image, write_request(0x0F, 0, MODBUS_MAX_WRITE_BITS + 1, Bytes(247, 0))) ==
+          exception(0x0F, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+    // Byte count too small for the quantity, or more than the request carries
+    CHECK(respond(image, write_request(0x0F, 1, 10, {0xFF})) == exception(0x0F, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+    Bytes truncated = write_request(0x0F, 1, 10, {0xFF, 0xFF});
+    truncated.pop_back();
+    CHECK(respond(image, truncated) == exception(0x0F, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+    CHECK(respond(image, write_request(0x0F, 15, 10, {0xFF, 0xFF})) == exception(0x0F, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS));
+    CHECK(!bit_at(image, Table::Coils, 15));
+}
+
+static void test_write_registers() {
+    ProcessImage image = make_image(BitLayout::Bytes);
+
+    CHECK(respond(image, write_request(0x10, 0, 2, {0x12, 0x34, 0x56, 0x78})) == adu(request(0x10, 0, 2)));
+    CHECK(register_at(image, Table::HoldingRegisters, 0) == 0x1234);
+    CHECK(register_at(image, Table::HoldingRegisters, 1) == 0x5678);
+    CHECK(register_at(image, Table::HoldingRegisters, 2) == 0);
+
+    CHECK(respond(image, write_request(0x10, 200, MODBUS_MAX_WRITE_REGISTERS, register_bytes(MODBUS_MAX_WRITE_REGISTERS, 1))) ==
+          adu(request(0x10, 200, MODBUS_MAX_WRITE_REGISTERS)));
+    CHECK(register_at(image, Table::HoldingRegisters, 200 + MODBUS_MAX_WRITE_REGISTERS - 1) == MODBUS_MAX_WRITE_REGISTERS);
+
+    CHECK(respond(image, write_request(0x10, 0, 0, {})) == exception(0x10, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+    CHECK(respond(image, write_request(0x10, 200, MODBUS_MAX_WRITE_REGISTERS + 1, register_bytes(MODBUS_MAX_WRITE_REGISTERS + 1, 0))) ==
+          exception(0x10, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+    CHECK(respond(image, write_request(0x10, 0, 2, {0, 1, 0})) == exception(0x10, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+    CHECK(respond(image, write_request(0x10, 9, 2, {0, 1, 0, 2})) == exception(0x10, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS));
+    CHECK(register_at(image, Table::HoldingRegisters, 9) == 0);
+}
+
+static void test_mask_write() {
+    ProcessImage image = make_image(BitLayout::Bytes);
+    CHECK(image.write_register(Table::HoldingRegisters, 3, 0x0012));
+
+    // (current AND and_mask) OR (or_mask AND NOT and_mask), the example of the specification; the reply echoes the request
+    Bytes mask = {0x16, 0x00, 0x03, 0x00, 0xF2, 0x00, 0x25};
+    CHECK(respond(image, mask) == adu(mask));
+    CHECK(register_at(image, Table::HoldingRegisters, 3) == 0x0017);
+
+    // An AND mask of all ones keeps the register, one of all zeros replaces it with the OR mask
+    CHECK(respond(image, {0x16, 0x00, 0x03, 0xFF, 0xFF, 0xAB, 0xCD}) == adu({0x16, 0x00, 0x03, 0xFF, 0xFF, 0xAB, 0xCD}));
+    CHECK(register_at(image, Table::HoldingRegisters, 3) == 0x0017);
+    CHECK(respond(image, {0x16, 0x00, 0x03, 0x00, 0x00, 0xAB, 0xCD}) == adu({0x16, 0x00, 0x03, 0x00, 0x00, 0xAB, 0xCD}));
+    CHECK(register_at(image, Table::HoldingRegisters, 3) == 0xABCD);
+
+    // One transaction per request
+    uint64_t generation = image.generation();
+    CHECK(respond(image, {0x16, 0x00, 0x04, 0x00, 0x00, 0x00, 0x01}) == adu({0x16, 0x00, 0x04, 0x00, 0x00, 0x00, 0x01}));
+    CHECK(image.generation() == generation + 1);
+
+    CHECK(respond(image, {0x16, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x01}) == exception(0x16, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS));
+    CHECK(respond(image, {0x16, 0x00, 0x03, 0x00, 0x00, 0x00}) == exception(0x16, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+    CHECK(register_at(image, Table::HoldingRegisters, 3) == 0xABCD);
+}
+
+// PDU of FC 23: read address and count, write address and count, byte count and the data bytes
+static Bytes write_read_request(int read_address, int read_count, int write_address, int write_count, const Bytes& data) {
+    Bytes pdu = request(0x17, read_address, read_count);
+    pdu.insert(pdu.end(), {high(write_address), low(write_address), high(write_count), low(write_count)});
+    pdu.push_back(static_cast<uint8_t>(data.size()));
+    pdu.insert(pdu.end(), data.begin(), data.end());
+    return pdu;
+}
+
+static void test_write_and_read() {
+    ProcessImage image = make_image(BitLayout::Bytes);
+    for (int address = 0; address < 10; address++) {
+        CHECK(image.write_register(Table::HoldingRegisters, address, static_cast<uint16_t>(address)));
+    }
+
+    // The write is applied first, so an overlapping read returns the new values; both are one transaction
+    uint64_t generation = image.generation();
+    CHECK(respond(image, write_read_request(0, 4, 1, 2, {0xAA, 0xAA, 0xBB, 0xBB})) ==
+          adu({0x17, 0x08, 0x00, 0x00, 0xAA, 0xAA, 0xBB, 0xBB, 0x00, 0x03}));
+    CHECK(image.generation() == generation + 1);
+
+    // Quantity limits: 125 registers read and 121 written
+    for (int address = 200; address < 330; address++) {
+        CHECK(image.write_register(Table::HoldingRegisters, address, static_cast<uint16_t>(address)));
+    }
+    Bytes largest = {0x17, 250};
+    Bytes values = register_bytes(MODBUS_MAX_WR_READ_REGISTERS, 200);
+    largest.insert(largest.end(), values.begin(), values.end());
+    CHECK(respond(image, write_read_request(200, MODBUS_MAX_WR_READ_REGISTERS, 0, 1, {0, 0})) == adu(largest));
+    CHECK(respond(image, write_read_request(0, 1, 200, MODBUS_MAX_WR_WRITE_REGISTERS,
+                                           register_bytes(MODBUS_MAX_WR_WRITE_REGISTERS, 0x1000))) ==
+          adu({0x17, 0x02, 0x00, 0x00}));
+    CHECK(register_at(image, Table::HoldingRegisters, 200 + MODBUS_MAX_WR_WRITE_REGISTERS - 1) ==
+          0x1000 + MODBUS_MAX_WR_WRITE_REGISTERS - 1);
+    CHECK(respond(image, write_read_request(200, MODBUS_MAX_WR_READ_REGISTERS + 1, 0, 1, {0, 0})) ==
+          exception(0x17, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+    CHECK(respond(image, write_read_request(0, 1, 200, MODBUS_MAX_WR_WRITE_REGISTERS + 1,
+                                           register_bytes(MODBUS_MAX_WR_WRITE_REGISTERS + 1, 0))) ==
+          exception(0x17, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+    CHECK(respond(image, write_read_request(0, 0, 0, 1, {0, 0})) == exception(0x17, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+    CHECK(respond(image, write_read_request(0, 1, 0, 0, {})) == exception(0x17, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+    CHECK(respond(image, write_read_request(0, 1, 0, 2, {0, 0})) == exception(0x17, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+
+    // Either part outside the image refuses the whole request, and nothing is written
+    CHECK(respond(image, write_read_request(9, 2, 0, 1, {0xEE, 0xEE})) == exception(0x17, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS));
+    CHECK(respond(image, write_read_request(0, 1, 9, 2, {0xEE, 0xEE, 0xEE, 0xEE})) ==
+          exception(0x17, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS));
+    CHECK(register_at(image, Table::HoldingRegisters, 0) == 0);
+    CHECK(register_at(image, Table::HoldingRegisters, 9) == 9);
+}
+
+static void test_malformed() {
+    ProcessImage image = make_image(BitLayout::Bytes);
+
+    // Too short to hold an address and a count, or a byte count
+    CHECK(respond(image, {0x03, 0x00, 0x00, 0x00}) == exception(0x03, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+    CHECK(respond(image, {0x0F, 0x00, 0x00, 0x00, 0x01}) == exception(0x0F, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE));
+
+    // Functions that are not encoded natively are left to the caller
+    CHECK(respond(image, request(0x07, 0, 0)).empty());
+    CHECK(respond(image, request(0x2B, 0x0E01, 0)).empty());
+
+    // The response keeps the transaction and unit IDs of the request
+    Bytes query = adu(request(0x03, 0, 1));
+    query[0] = 0xAB;
+    query[1] = 0xCD;
+    query[6] = 0xFF;
+    Bytes response = respond_to(image, query);
+    CHECK(response.size() == 11 && response[0] == 0xAB && response[1] == 0xCD && response[6] == 0xFF);
+}
+
+int main() {
+    for (BitLayout layout : {BitLayout::Bytes, BitLayout::Packed}) {
+        test_read_bits(layout);
+        test_write_coils(layout);
+    }
+    test_read_registers();
+    test_write_single();
+    test_write_registers();
+    test_mask_write();
+    test_write_and_read();
+    test_malformed();
+
+    return test_result("test_modbus_handler");
+}
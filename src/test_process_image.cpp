@@ -0,0 +1,207 @@
+#include "process_image.h"
+#include "test_check.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Standalone checks of ProcessImage: the packed bit layout behaves exactly
+// like the byte layout, readers see the same values from the mirror while a
+// transaction is open, and change tracking reports every modified block and
+// nothing else. Exits non-zero on failure.
+
+using Table = ProcessImage::Table;
+using BitLayout = ProcessImage::BitLayout;
+
+// Two address blocks per bit table, with sizes that are not multiples of eight
+static const std::vector<AddressSegment> COILS = {{0, 100}, {1000, 203}};
+static const std::vector<AddressSegment> DISCRETE_INPUTS = {{10, 77}, {500, 9}};
+static const std::vector<AddressSegment> REGISTERS = {{0, 16}};
+
+static void test_packed_matches_bytes() {
+    ProcessImage bytes(COILS, DISCRETE_INPUTS, REGISTERS, REGISTERS, {}, BitLayout::Bytes);
+    ProcessImage packed(COILS, DISCRETE_INPUTS, REGISTERS, REGISTERS, {}, BitLayout::Packed);
+    std::mt19937 rng(7);
+
+    for (int round = 0; round < 20000; round++) {
+        Table table = rng() % 2 ? Table::Coils : Table::DiscreteInputs;
+        int size = bytes.size(table);
+        CHECK(packed.size(table) == size);
+        int index = static_cast<int>(rng() % static_cast<unsigned>(size));
+        int count = 1 + static_cast<int>(rng() % static_cast<unsigned>(size - index));
+
+        // Same write to both images, as bytes (PLC commit, FC5) or in wire format (FC15)
+        uint8_t values[400];
+        uint8_t wire[64];
+        for (int i = 0; i < count; i++) {
+            values[i] = static_cast<uint8_t>(rng() % 3);
+        }
+        for (auto& byte : wire) {
+            byte = static_cast<uint8_t>(rng());
+        }
+        bool as_wire = rng() % 2;
+        for (ProcessImage* image : {&bytes, &packed}) {
+            ProcessImage::Transaction transaction(*image);
+            if (as_wire) {
+                transaction.write_packed_bits(table, index, count, wire);
+            } else {
+                transaction.write_bits(table, index, count, values);
+            }
+        }
+
+        // Any range reads back the same, one byte per bit (PLC scan) and packed (FC1/FC2)
+        int read_index = static_cast<int>(rng() % static_cast<unsigned>(size));
+        int read_count = 1 + static_cast<int>(rng() % static_cast<unsigned>(size - read_index));
+        uint8_t bytes_out[400];
+        uint8_t packed_out[400];
+        uint8_t bytes_wire[64] = {};
+        uint8_t packed_wire[64];
+        // pack_bits must clear the unused high bits itself
+        std::memset(packed_wire, 0xFF, sizeof(packed_wire));
+        bytes.read([&](const ProcessImage::Tables& tables) {
+            tables.copy_bits(table, read_index, read_count, bytes_out);
+            tables.pack_bits(table, read_index, read_count, bytes_wire);
+        });
+        packed.read([&](const ProcessImage::Tables& tables) {
+            tables.copy_bits(table, read_index, read_count, packed_out);
+            tables.pack_bits(table, read_index, read_count, packed_wire);
+        });
+        auto wire_bytes = static_cast<size_t>((read_count + 7) / 8);
+        if (std::memcmp(bytes_out, packed_out, static_cast<size_t>(read_count)) != 0 ||
+            std::memcmp(bytes_wire, packed_wire, wire_bytes) != 0) {
+            std::cerr << "layouts differ reading " << read_count << " bits at " << read_index << std::endl;
+            failures++;
+        }
+    }
+
+    // Single bits by Modbus address, across both blocks
+    for (const auto& segment : COILS) {
+        for (int address = segment.start; address < segment.start + segment.count; address++) {
+            bool a = false;
+            bool b = true;
+            CHECK(bytes.read_bit(Table::Coils, address, a));
+            CHECK(packed.read_bit(Table::Coils, address, b));
+            CHECK(a == b);
+        }
+    }
+    bool unused = false;
+    CHECK(!packed.read_bit(Table::Coils, 100, unused));
+    CHECK(!packed.write_bit(Table::Coils, 999, true));
+}
+
+static void test_packed_neighbours() {
+    ProcessImage image(COILS, DISCRETE_INPUTS, REGISTERS, REGISTERS, {}, BitLayout::Packed);
+    {
+        ProcessImage::Transaction transaction(image);
+        std::vector<uint8_t> ones(static_cast<size_t>(image.size(Table::Coils)), 1);
+        transaction.write_bits(Table::Coils, 0, image.size(Table::Coils), ones.data());
+    }
+
+    // Clearing bits 13..18 must leave the other bits of the bytes they share untouched
+    uint8_t zeros[6] = {};
+    {
+        ProcessImage::Transaction transaction(image);
+        transaction.write_bits(Table::Coils, 13, 6, zeros);
+        CHECK(transaction.bit(Table::Coils, 12));
+        CHECK(!transaction.bit(Table::Coils, 13));
+        CHECK(!transaction.bit(Table::Coils, 18));
+        CHECK(transaction.bit(Table::Coils, 19));
+    }
+    for (int index = 0; index < image.size(Table::Coils); index++) {
+        bool expected = index < 13 || index > 18;
+        bool value = false;
+        image.read([&](const ProcessImage::Tables& tables) { value = tables.bit(Table::Coils, index); });
+        if (value != expected) {
+            std::cerr << "coil index " << index << " is " << value << std::endl;
+            failures++;
+        }
+    }
+}
+
+static void test_mirror_follows_primary() {
+    for (BitLayout layout : {BitLayout::Bytes, BitLayout::Packed}) {
+        ProcessImage image(COILS, DISCRETE_INPUTS, REGISTERS, REGISTERS, {}, layout);
+        std::mt19937 rng(11);
+        for (int round = 0; round < 500; round++) {
+            int size = image.size(Table::Coils);
+            int index = static_cast<int>(rng() % static_cast<unsigned>(size));
+            int count = 1 + static_cast<int>(rng() % static_cast<unsigned>(size - index));
+            std::vector<uint8_t> values(static_cast<size_t>(count));
+            for (auto& value : values) {
+                value = static_cast<uint8_t>(rng() % 2);
+            }
+            {
+                ProcessImage::Transaction transaction(image);
+                transaction.write_bits(Table::Coils, index, count, values.data());
+            }
+
+            // With a transaction open readers use the mirror, which must match the published primary
+            ProcessImage::Transaction transaction(image);
+            std::vector<uint8_t> mirror(static_cast<size_t>(size));
+            image.read([&](const ProcessImage::Tables& tables) {
+                tables.copy_bits(Table::Coils, 0, size, mirror.data());
+            });
+            for (int i = 0; i < size; i++) {
+                if ((mirror[static_cast<size_t>(i)] != 0) != transaction.bit(Table::Coils, i)) {
+                    std::cerr << "mirror differs at coil index " << i << std::endl;
+                    failures++;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static void test_change_tracking() {
+    const int block = ProcessImage::CHANGE_BLOCK;
+    ProcessImage image(COILS, DISCRETE_INPUTS, {{0, 10 * block + 5}}, REGISTERS);
+    uint64_t start = image.generation();
+    CHECK(!image.changed_since(Table::HoldingRegisters, 0, image.size(Table::HoldingRegisters), start));
+
+    {
+        ProcessImage::Transaction transaction(image);
+        *transaction.modify_registers(Table::HoldingRegisters, 2 * block + 3, 1) = 1;
+        std::fill_n(transaction.modify_registers(Table::HoldingRegisters, 5 * block - 1, 3), 3, 2);
+    }
+    uint64_t first = image.generation();
+    CHECK(first == start + 1);
+
+    // Tracked per block: the whole block of a change counts, the others do not
+    CHECK(image.changed_since(Table::HoldingRegisters, 2 * block, 1, start));
+    CHECK(!image.changed_since(Table::HoldingRegisters, 3 * block, block, start));
+    CHECK(image.changed_since(Table::HoldingRegisters, 5 * block + 1, 1, start));
+    CHECK(!image.changed_since(Table::HoldingRegisters, 0, image.size(Table::HoldingRegisters), first));
+    CHECK(!image.changed_since(Table::InputRegisters, 0, image.size(Table::InputRegisters), start));
+
+    // Adjacent modified blocks are reported as one run
+    std::vector<std::pair<int, int>> runs;
+    image.for_each_change(Table::HoldingRegisters, start, [&](int index, int count) {
+        runs.emplace_back(index, count);
+    });
+    CHECK((runs == std::vector<std::pair<int, int>>{{2 * block, block}, {4 * block, 2 * block}}));
+
+    // The partial last block ends at the table size
+    {
+        ProcessImage::Transaction transaction(image);
+        *transaction.modify_registers(Table::HoldingRegisters, 10 * block + 4, 1) = 3;
+        uint8_t bit = 1;
+        transaction.write_bits(Table::Coils, 150, 1, &bit);
+    }
+    runs.clear();
+    image.for_each_change(Table::HoldingRegisters, first, [&](int index, int count) {
+        runs.emplace_back(index, count);
+    });
+    CHECK((runs == std::vector<std::pair<int, int>>{{10 * block, 5}}));
+    CHECK(image.changed_since(Table::Coils, 150, 1, first));
+    CHECK(!image.changed_since(Table::Coils, 0, 100, first));
+}
+
+int main() {
+    test_packed_matches_bytes();
+    test_packed_neighbours();
+    test_mirror_follows_primary();
+    test_change_tracking();
+
+    return test_result("test_process_image");
+}
@@ -0,0 +1,125 @@
+#include "platform.h"  // Include platform.h first for platform-specific definitions
+#include "modbus_handler.h"
+#include "response_cache.h"
+#include "test_check.h"
+#include <vector>
+
+// Standalone checks of ResponseCache behind ModbusHandler::build_standard_response:
+// a repeated read is answered from the cache under the new request's transaction
+// ID, and any write to the blocks it covers, over Modbus or from the PLC side,
+// makes the next read encode afresh. Exits non-zero on failure.
+
+using Bytes = std::vector<uint8_t>;
+using Table = ProcessImage::Table;
+
+static const int BLOCK = ProcessImage::CHANGE_BLOCK;
+
+// One ADU for the given transaction and unit: MBAP header followed by the PDU
+static Bytes adu(uint16_t transaction_id, uint8_t unit, const Bytes& pdu) {
+    auto length = static_cast<uint16_t>(pdu.size() + 1);
+    Bytes frame = {
+        static_cast<uint8_t>(transaction_id >> 8), static_cast<uint8_t>(transaction_id & 0xFF),
+        0, 0,
+        static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length & 0xFF),
+        unit
+    };
+    frame.insert(frame.end(), pdu.begin(), pdu.end());
+    return frame;
+}
+
+// PDU of a request made of a function code and two 16-bit fields, e.g. address and count
+static Bytes request(uint8_t function, int first, int second) {
+    return {function, static_cast<uint8_t>(first >> 8), static_cast<uint8_t>(first & 0xFF),
+            static_cast<uint8_t>(second >> 8), static_cast<uint8_t>(second & 0xFF)};
+}
+
+static Bytes respond(ProcessImage& image, ResponseCache& cache, const Bytes& query) {
+    uint8_t response[MODBUS_TCP_MAX_ADU_LENGTH];
+    int length = ModbusHandler::build_standard_response(query.data(), static_cast<int>(query.size()), image,
+                                                        response, &cache);
+    return Bytes(response, response + length);
+}
+
+static void test_hit_keeps_transaction_id() {
+    ProcessImage image({{0, 16}}, {{0, 16}}, {{0, 4 * BLOCK}}, {{0, 16}});
+    ResponseCache cache;
+    CHECK(image.write_register(Table::HoldingRegisters, 1, 0x1234));
+
+    Bytes first = respond(image, cache, adu(1, 1, request(0x03, 0, 3)));
+    CHECK(first == adu(1, 1, {0x03, 0x06, 0x00, 0x00, 0x12, 0x34, 0x00, 0x00}));
+    CHECK(cache.hits() == 0 && cache.misses() == 1);
+
+    // Same bytes after the header, but the IDs of the new request
+    Bytes second = respond(image, cache, adu(0xBEEF, 1, request(0x03, 0, 3)));
+    CHECK(cache.hits() == 1);
+    CHECK(second == adu(0xBEEF, 1, {0x03, 0x06, 0x00, 0x00, 0x12, 0x34, 0x00, 0x00}));
+
+    // Unit, function, address and count are all part of the key
+    respond(image, cache, adu(2, 7, request(0x03, 0, 3)));
+    respond(image, cache, adu(3, 1, request(0x04, 0, 3)));
+    respond(image, cache, adu(4, 1, request(0x03, 1, 3)));
+    respond(image, cache, adu(5, 1, request(0x03, 0, 2)));
+    CHECK(cache.hits() == 1 && cache.misses() == 5);
+}
+
+static void test_write_invalidates() {
+    ProcessImage image({{0, 16}}, {{0, 16}}, {{0, 4 * BLOCK}}, {{0, 16}}, {}, ProcessImage::BitLayout::Packed);
+    ResponseCache cache;
+    Bytes read = adu(1, 1, request(0x03, 0, 2));
+    respond(image, cache, read);
+
+    // A Modbus write inside the range bumps the block's generation: the next read encodes again
+    CHECK(respond(image, cache, adu(2, 1, request(0x06, 1, 0x5555))) == adu(2, 1, request(0x06, 1, 0x5555)));
+    uint64_t hits = cache.hits();
+    CHECK(respond(image, cache, read) == adu(1, 1, {0x03, 0x04, 0x00, 0x00, 0x55, 0x55}));
+    CHECK(cache.hits() == hits);
+    // ... and is cached again
+    CHECK(respond(image, cache, read) == adu(1, 1, {0x03, 0x04, 0x00, 0x00, 0x55, 0x55}));
+    CHECK(cache.hits() == hits + 1);
+
+    // A write to another block leaves the entry valid
+    CHECK(image.write_register(Table::HoldingRegisters, 3 * BLOCK, 9));
+    CHECK(respond(image, cache, read) == adu(1, 1, {0x03, 0x04, 0x00, 0x00, 0x55, 0x55}));
+    CHECK(cache.hits() == hits + 2);
+
+    // A write from the PLC side in the same block, even outside the range read, also invalidates
+    {
+        ProcessImage::Transaction transaction(image);
+        *transaction.modify_registers(Table::HoldingRegisters, 0, 1) = 0x0102;
+    }
+    CHECK(respond(image, cache, read) == adu(1, 1, {0x03, 0x04, 0x01, 0x02, 0x55, 0x55}));
+    CHECK(cache.hits() == hits + 2);
+
+    // Coils: a Write Single Coil is seen by the next Read Coils
+    Bytes read_coils = adu(3, 1, request(0x01, 0, 16));
+    CHECK(respond(image, cache, read_coils) == adu(3, 1, {0x01, 0x02, 0x00, 0x00}));
+    respond(image, cache, adu(4, 1, request(0x05, 9, 0xFF00)));
+    CHECK(respond(image, cache, read_coils) == adu(3, 1, {0x01, 0x02, 0x00, 0x02}));
+}
+
+static void test_stale_store() {
+    // A response encoded from a generation that a write has since overtaken is never served
+    ProcessImage image({{0, 16}}, {{0, 16}}, {{0, 16}}, {{0, 16}});
+    ResponseCache cache;
+    Bytes query = adu(1, 1, request(0x03, 0, 1));
+    uint64_t generation = image.generation();
+    const uint8_t stale[] = {0x03, 0x02, 0x00, 0x00};
+    CHECK(image.write_register(Table::HoldingRegisters, 0, 7));
+    cache.store(query.data(), generation, Table::HoldingRegisters, 0, 1, stale, sizeof(stale));
+
+    uint8_t pdu[ResponseCache::MAX_PDU];
+    CHECK(cache.lookup(query.data(), image, Table::HoldingRegisters, 0, 1, pdu) == 0);
+    CHECK(respond(image, cache, query) == adu(1, 1, {0x03, 0x02, 0x00, 0x07}));
+
+    // The fresh encoding replaces it and is served from then on
+    CHECK(cache.lookup(query.data(), image, Table::HoldingRegisters, 0, 1, pdu) == 4);
+    CHECK(pdu[3] == 0x07);
+}
+
+int main() {
+    test_hit_keeps_transaction_id();
+    test_write_invalidates();
+    test_stale_store();
+
+    return test_result("test_response_cache");
+}
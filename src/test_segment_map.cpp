@@ -0,0 +1,120 @@
+#include "segment_map.h"
+#include "test_check.h"
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Standalone checks of SegmentMap: merging of unsorted, overlapping, adjacent
+// and out-of-range blocks, and address translation compared with a plain
+// per-address reference over the whole address space. Exits non-zero on failure.
+
+static bool same_segments(const SegmentMap& map, const std::vector<AddressSegment>& expected) {
+    const auto& segments = map.segments();
+    if (segments.size() != expected.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < segments.size(); i++) {
+        if (segments[i].start != expected[i].start || segments[i].count != expected[i].count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_merging() {
+    // Unsorted, overlapping, touching and contained blocks
+    SegmentMap merged({{200, 10}, {0, 10}, {5, 10}, {15, 5}, {100, 50}, {120, 5}, {205, 20}});
+    CHECK(same_segments(merged, {{0, 20}, {100, 50}, {200, 25}}));
+    CHECK(merged.size() == 95);
+
+    // Empty and negative blocks vanish; blocks are clipped to the address space
+    SegmentMap clipped({{-10, 15}, {30, 0}, {40, -3}, {65530, 100}, {70000, 5}});
+    CHECK(same_segments(clipped, {{0, 5}, {65530, 6}}));
+    CHECK(clipped.size() == 11);
+
+    SegmentMap empty({});
+    int index = -1;
+    CHECK(empty.size() == 0);
+    CHECK(!empty.translate(0, 1, index));
+}
+
+static void test_translation_edges() {
+    SegmentMap map({{0, 100}, {9000, 1000}, {64, 0}});
+    int index = -1;
+    CHECK(map.translate(0, 100, index) && index == 0);
+    CHECK(map.translate(99, 1, index) && index == 99);
+    CHECK(!map.translate(99, 2, index));     // Runs past the end of the block
+    CHECK(map.translate(9000, 1, index) && index == 100);
+    CHECK(map.translate(9999, 1, index) && index == 1099);
+    CHECK(!map.translate(10000, 1, index));
+    CHECK(!map.translate(8999, 2, index));   // Starts in the gap
+    CHECK(!map.translate(50, 0, index));     // Empty range
+    CHECK(!map.translate(-1, 1, index));
+    CHECK(!map.translate(SegmentMap::ADDRESS_SPACE, 1, index));
+}
+
+static void test_random_layouts() {
+    std::mt19937 rng(99);
+    for (int round = 0; round < 200; round++) {
+        // Many small blocks with gaps of a few addresses, so several end in one 64-address page
+        std::vector<AddressSegment> segments;
+        int blocks = 1 + static_cast<int>(rng() % 60);
+        int span = rng() % 2 ? 512 : SegmentMap::ADDRESS_SPACE;
+        for (int i = 0; i < blocks; i++) {
+            segments.push_back({static_cast<int>(rng() % static_cast<unsigned>(span)), 1 + static_cast<int>(rng() % 40)});
+        }
+
+        // Reference: which addresses are mapped, numbered in address order
+        std::vector<int> reference(SegmentMap::ADDRESS_SPACE, -1);
+        for (const auto& segment : segments) {
+            for (int address = segment.start; address < segment.start + segment.count && address < SegmentMap::ADDRESS_SPACE; address++) {
+                reference[static_cast<size_t>(address)] = 0;
+            }
+        }
+        int next = 0;
+        for (int& entry : reference) {
+            if (entry == 0) {
+                entry = next++;
+            }
+        }
+
+        SegmentMap map(segments);
+        CHECK(map.size() == next);
+        bool ok = true;
+        for (int address = 0; address < SegmentMap::ADDRESS_SPACE && ok; address++) {
+            int index = -1;
+            bool mapped = map.translate(address, 1, index);
+            ok = mapped == (reference[static_cast<size_t>(address)] >= 0) &&
+                 (!mapped || index == reference[static_cast<size_t>(address)]);
+        }
+        if (!ok) {
+            std::cerr << "single-address translation differs in round " << round << std::endl;
+            failures++;
+        }
+
+        // A range translates only if every address is mapped, and then to consecutive indices
+        for (int probe = 0; probe < 2000; probe++) {
+            int address = static_cast<int>(rng() % static_cast<unsigned>(span));
+            int count = 1 + static_cast<int>(rng() % 50);
+            bool expected = address + count <= SegmentMap::ADDRESS_SPACE;
+            for (int i = 0; i < count && expected; i++) {
+                int entry = reference[static_cast<size_t>(address + i)];
+                expected = entry >= 0 && entry == reference[static_cast<size_t>(address)] + i;
+            }
+            int index = -1;
+            bool mapped = map.translate(address, count, index);
+            if (mapped != expected || (mapped && index != reference[static_cast<size_t>(address)])) {
+                std::cerr << "range " << address << "+" << count << " translates wrongly in round " << round << std::endl;
+                failures++;
+            }
+        }
+    }
+}
+
+int main() {
+    test_merging();
+    test_translation_edges();
+    test_random_layouts();
+
+    return test_result("test_segment_map");
+}
@@ -0,0 +1,158 @@
+#include "timer_wheel.h"
+#include "test_check.h"
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Standalone checks of TimerWheel: timers on every level cascade down and fire
+// on the first advance() past their deadline, never before it; cancelled and
+// re-armed timers fire once at their last deadline. Exits non-zero on failure.
+
+// Ticks spanned by levels 0 .. n-1
+static constexpr uint64_t level_span(unsigned levels) {
+    return uint64_t{1} << (TimerWheel::SLOT_BITS * levels);
+}
+
+// Advances to now and records when each collected timer fired; every timer may fire once
+static void collect(TimerWheel& wheel, uint64_t now, std::vector<uint64_t>& fired_at) {
+    wheel.advance(now);
+    while (TimerWheel::Timer* timer = wheel.pop_expired()) {
+        auto id = static_cast<size_t>(timer->id);
+        CHECK(fired_at[id] == 0);
+        fired_at[id] = now;
+    }
+}
+
+static void test_level_boundaries() {
+    // An odd start puts the first wraps of every level at unaligned distances
+    const uint64_t start = 1000003;
+    TimerWheel wheel(start, 1);
+
+    std::vector<uint64_t> delays;
+    for (unsigned level = 1; level < TimerWheel::LEVELS; level++) {
+        for (int64_t offset = -2; offset <= 2; offset++) {
+            delays.push_back(static_cast<uint64_t>(static_cast<int64_t>(level_span(level)) + offset));
+        }
+    }
+    delays.push_back(0);
+    delays.push_back(1);
+
+    std::vector<TimerWheel::Timer> timers(delays.size());
+    std::vector<uint64_t> fired_at(delays.size(), 0);
+    for (size_t i = 0; i < delays.size(); i++) {
+        timers[i].id = static_cast<int>(i);
+        wheel.schedule(timers[i], start + delays[i]);
+    }
+
+    // One tick at a time, so every timer must fire exactly at its deadline
+    uint64_t end = start + level_span(3) + 4;
+    for (uint64_t now = start; now <= end; now++) {
+        collect(wheel, now, fired_at);
+    }
+    for (size_t i = 0; i < delays.size(); i++) {
+        if (fired_at[i] != start + delays[i]) {
+            std::cerr << "timer with delay " << delays[i] << " fired at +" << fired_at[i] - start << std::endl;
+            failures++;
+        }
+    }
+}
+
+static void test_random_deadlines() {
+    std::mt19937_64 rng(42);
+    const uint64_t start = 123456789;
+    const uint64_t tick_ms = 10;
+    const size_t count = 5000;
+    // Declared first, so any timer left armed is detached before it goes away
+    std::vector<TimerWheel::Timer> timers(count);
+    TimerWheel wheel(start, tick_ms);
+
+    std::vector<uint64_t> deadlines(count);
+    std::vector<uint64_t> fired_at(count, 0);
+    std::vector<bool> cancelled(count, false);
+    std::uniform_int_distribution<uint64_t> delay(0, level_span(3) * tick_ms);
+    uint64_t last_deadline = start;
+    for (size_t i = 0; i < count; i++) {
+        timers[i].id = static_cast<int>(i);
+        deadlines[i] = start + delay(rng);
+        last_deadline = std::max(last_deadline, deadlines[i]);
+        wheel.schedule(timers[i], deadlines[i]);
+    }
+
+    // Uneven steps skip many ticks per advance(), and timers are cancelled or re-armed along the way
+    uint64_t previous = start;
+    uint64_t now = start;
+    std::uniform_int_distribution<uint64_t> step(1, 5000);
+    while (now < last_deadline + tick_ms) {
+        now += step(rng);
+        collect(wheel, now, fired_at);
+        for (size_t i = 0; i < count; i++) {
+            if (fired_at[i] == now) {
+                // Rounded up to the tick: never before the deadline, and no later than this step
+                uint64_t due = (deadlines[i] + tick_ms - 1) / tick_ms * tick_ms;
+                CHECK(due <= now);
+                CHECK(due > previous - previous % tick_ms);
+            }
+        }
+
+        size_t victim = static_cast<size_t>(rng() % count);
+        if (fired_at[victim] == 0 && !cancelled[victim]) {
+            if (rng() & 1) {
+                timers[victim].cancel();
+                cancelled[victim] = true;
+            } else {
+                deadlines[victim] = now + 1 + delay(rng) / 4;
+                last_deadline = std::max(last_deadline, deadlines[victim]);
+                wheel.schedule(timers[victim], deadlines[victim]);
+            }
+        }
+        previous = now;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        CHECK((fired_at[i] != 0) != cancelled[i]);
+        CHECK(!timers[i].linked());
+    }
+}
+
+static void test_past_and_far_deadlines() {
+    const uint64_t start = 5000;
+    TimerWheel wheel(start, 1);
+    std::vector<uint64_t> fired_at(2, 0);
+
+    TimerWheel::Timer past;
+    past.id = 0;
+    wheel.schedule(past, start - 100);
+    collect(wheel, start, fired_at);
+    CHECK(fired_at[0] == start);
+
+    // Clamped to the wheel's range instead of wrapping around to an early slot
+    TimerWheel::Timer far;
+    far.id = 1;
+    wheel.schedule(far, start + level_span(TimerWheel::LEVELS) * 4);
+    collect(wheel, start + level_span(TimerWheel::LEVELS) / 2, fired_at);
+    CHECK(fired_at[1] == 0);
+    CHECK(far.linked());
+    far.cancel();
+    CHECK(!far.linked());
+}
+
+static void test_timer_outlives_wheel() {
+    TimerWheel::Timer timer;
+    {
+        TimerWheel wheel(0, 1);
+        wheel.schedule(timer, 1000);
+        CHECK(timer.linked());
+    }
+    CHECK(!timer.linked());
+    timer.cancel();
+}
+
+int main() {
+    test_level_boundaries();
+    test_random_deadlines();
+    test_past_and_far_deadlines();
+    test_timer_outlives_wheel();
+
+    return test_result("test_timer_wheel");
+}
@@ -0,0 +1,126 @@
+#include "timer_wheel.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+    constexpr uint64_t SLOT_MASK = TimerWheel::SLOTS - 1;
+
+    // Longest delay the wheel can represent, in ticks
+    constexpr uint64_t MAX_DELAY = (uint64_t{1} << (TimerWheel::SLOT_BITS * TimerWheel::LEVELS)) - 1;
+
+    void make_empty(TimerWheel::Timer& head) {
+        head.prev = &head;
+        head.next = &head;
+    }
+
+    // Unlinks every node of a list, leaving the sentinel empty
+    void detach_all(TimerWheel::Timer& head) {
+        TimerWheel::Timer* node = head.next;
+        while (node != &head) {
+            TimerWheel::Timer* next = node->next;
+            node->prev = nullptr;
+            node->next = nullptr;
+            node = next;
+        }
+        make_empty(head);
+    }
+}
+
+void TimerWheel::Timer::cancel() {
+    if (linked()) {
+        prev->next = next;
+        next->prev = prev;
+        prev = nullptr;
+        next = nullptr;
+    }
+}
+
+TimerWheel::TimerWheel(uint64_t now_ms, uint64_t tick_ms)
+    : tick_ms_(std::max<uint64_t>(tick_ms, 1)), next_tick_(now_ms / tick_ms_) {
+    for (auto& level : slots_) {
+        for (auto& slot : level) {
+            make_empty(slot);
+        }
+    }
+    make_empty(expired_);
+}
+
+TimerWheel::~TimerWheel() {
+    // Owners may outlive the wheel and cancel() their timers later
+    for (auto& level : slots_) {
+        for (auto& slot : level) {
+            detach_all(slot);
+        }
+    }
+    detach_all(expired_);
+}
+
+void TimerWheel::push_back(Timer& head, Timer& timer) {
+    timer.prev = head.prev;
+    timer.next = &head;
+    head.prev->next = &timer;
+    head.prev = &timer;
+}
+
+void TimerWheel::insert(Timer& timer) {
+    uint64_t delay = timer.expires - next_tick_;
+    unsigned level = 0;
+    while (level + 1 < LEVELS && delay >= (uint64_t{1} << (SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+    push_back(slots_[level][(timer.expires >> (SLOT_BITS * level)) & SLOT_MASK], timer);
+}
+
+void TimerWheel::schedule(Timer& timer, uint64_t deadline_ms) {
+    timer.cancel();
+    // Round up so a timer never fires before its deadline
+    uint64_t ticks = (deadline_ms + tick_ms_ - 1) / tick_ms_;
+    timer.expires = std::clamp(ticks, next_tick_, next_tick_ + MAX_DELAY);
+    insert(timer);
+}
+
+unsigned TimerWheel::cascade(unsigned level, unsigned slot) {
+    Timer& head = slots_[level][slot];
+    Timer* node = head.next;
+    make_empty(head);
+    while (node != &head) {
+        Timer* next = node->next;
+        insert(*node);
+        node = next;
+    }
+    return slot;
+}
+
+void TimerWheel::advance(uint64_t now_ms) {
+    uint64_t now_tick = now_ms / tick_ms_;
+    while (next_tick_ <= now_tick) {
+        unsigned slot = static_cast<unsigned>(next_tick_ & SLOT_MASK);
+
+        // Each time a level wraps, the matching slot of the level above is due to move down
+        for (unsigned level = 1; slot == 0 && level < LEVELS; level++) {
+            slot = cascade(level, static_cast<unsigned>((next_tick_ >> (SLOT_BITS * level)) & SLOT_MASK));
+        }
+
+        Timer& head = slots_[0][next_tick_ & SLOT_MASK];
+        while (head.next != &head) {
+            Timer* timer = head.next;
+            timer->cancel();
+            push_back(expired_, *timer);
+        }
+        next_tick_++;
+    }
+}
+
+TimerWheel::Timer* TimerWheel::pop_expired() {
+    if (expired_.next == &expired_) {
+        return nullptr;
+    }
+    Timer* timer = expired_.next;
+    timer->cancel();
+    return timer;
+}
+
+uint64_t TimerWheel::now_ms() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class TimerWheel
+ * @brief Hierarchical timing wheel with O(1) scheduling and cancellation
+ *
+ * Four levels of 64 slots cover delays from one tick up to 64^4 ticks; a
+ * timer is placed on the coarsest level that still resolves it and cascades
+ * down one level each time the level below wraps. Timers are intrusive list
+ * nodes embedded in their owner, so arming, re-arming and cancelling never
+ * allocate and never search. A wheel is owned by a single thread.
+ */
+class TimerWheel {
+public:
+    /// Number of levels in the hierarchy
+    static constexpr unsigned LEVELS = 4;
+
+    /// log2 of the number of slots per level
+    static constexpr unsigned SLOT_BITS = 6;
+
+    /// Number of slots per level
+    static constexpr unsigned SLOTS = 1u << SLOT_BITS;
+
+    /**
+     * @struct Timer
+     * @brief Timer node embedded in the object it times
+     */
+    struct Timer {
+        Timer* prev = nullptr;   ///< Previous node in the slot list
+        Timer* next = nullptr;   ///< Next node in the slot list
+        uint64_t expires = 0;    ///< Expiry, in ticks
+        int id = -1;             ///< Owner identifier, e.g. a socket descriptor
+
+        /**
+         * @brief Check whether the timer is armed or expired but not yet collected
+         *
+         * @return true if the node is on one of the wheel's lists
+         */
+        bool linked() const { return next != nullptr; }
+
+        /**
+         * @brief Remove the timer from its wheel; no-op if it is not armed
+         */
+        void cancel();
+    };
+
+    /**
+     * @brief Constructor
+     *
+     * @param now_ms Current time in milliseconds, see now_ms()
+     * @param tick_ms Wheel resolution in milliseconds
+     */
+    explicit TimerWheel(uint64_t now_ms, uint64_t tick_ms = 10);
+
+    /**
+     * @brief Destructor - detaches every timer still on the wheel
+     */
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /**
+     * @brief Arm or re-arm a timer
+     *
+     * Deadlines in the past fire on the next tick; deadlines beyond the
+     * wheel's range are clamped to it.
+     *
+     * @param timer Timer to arm
+     * @param deadline_ms Absolute expiry in milliseconds
+     */
+    void schedule(Timer& timer, uint64_t deadline_ms);
+
+    /**
+     * @brief Advance the wheel to the given time and collect every due timer
+     *
+     * @param now_ms Current time in milliseconds
+     */
+    void advance(uint64_t now_ms);
+
+    /**
+     * @brief Take the next timer collected by advance()
+     *
+     * @return The expired timer, now unlinked, or nullptr if none is left
+     */
+    Timer* pop_expired();
+
+    /**
+     * @brief Monotonic clock in milliseconds used for deadlines
+     *
+     * @return Milliseconds since an arbitrary fixed point
+     */
+    static uint64_t now_ms();
+
+private:
+    /**
+     * @brief Move every timer of one slot back onto the wheel one level down
+     *
+     * @param level Level of the slot
+     * @param slot Slot index
+     * @return The slot index, so the caller knows whether this level wrapped too
+     */
+    unsigned cascade(unsigned level, unsigned slot);
+
+    /**
+     * @brief Put a timer on the slot matching its expiry
+     *
+     * @param timer Unlinked timer
+     */
+    void insert(Timer& timer);
+
+    /**
+     * @brief Append a node to a list
+     *
+     * @param head List sentinel
+     * @param timer Unlinked node
+     */
+    static void push_back(Timer& head, Timer& timer);
+
+    Timer slots_[LEVELS][SLOTS];   ///< Slot list sentinels
+    Timer expired_;                ///< Timers collected by advance()
+    uint64_t tick_ms_;             ///< Milliseconds per tick
+    uint64_t next_tick_;           ///< Next tick to be processed
+};